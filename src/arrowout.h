@@ -0,0 +1,192 @@
+/**************************************/
+/*                                    */
+/*  Arrow IPC / Parquet output        */
+/*                                    */
+/**************************************/
+
+#ifndef ARROWOUT_H_GUARD
+#define ARROWOUT_H_GUARD
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "columns.h"
+
+#ifdef __ARROW__
+
+#include <arrow/api.h>
+#include <arrow/io/file.h>
+#include <arrow/ipc/writer.h>
+#ifdef __PARQUET__
+#include <parquet/arrow/writer.h>
+#endif
+
+// Writes the registered columns as Arrow record batches, one batch per
+// HIPO record. Event columns become plain values (null when the bank is
+// missing), every other column a list with the rows of the event.
+// The batches are built directly from the joined vectors, ROOT does not
+// see any of it. Files ending in .parquet are written as Parquet when
+// built with Parquet support, anything else as an Arrow IPC (Feather v2) file.
+class ArrowOutput {
+ private:
+  std::vector<Column *> columns;
+  std::vector<std::shared_ptr<arrow::ArrayBuilder>> builders;
+  std::shared_ptr<arrow::Schema> schema;
+  std::shared_ptr<arrow::io::FileOutputStream> stream;
+  std::shared_ptr<arrow::ipc::RecordBatchWriter> ipc;
+#ifdef __PARQUET__
+  std::unique_ptr<parquet::arrow::FileWriter> parquet;
+#endif
+  long rows = 0;
+  long bytesWritten = 0;
+
+  static void check(const arrow::Status &status, const char *what) {
+    if (!status.ok()) {
+      std::cerr << "[ERROR] arrow " << what << " : " << status.ToString() << std::endl;
+      exit(1);
+    }
+  }
+
+  static std::shared_ptr<arrow::DataType> dataType(int type) {
+    switch (type) {
+      case COLUMN_CHAR: return arrow::int8();
+      case COLUMN_SHORT: return arrow::int16();
+      case COLUMN_INT: return arrow::int32();
+      case COLUMN_LONG: return arrow::int64();
+      default: return arrow::float32();
+    }
+  }
+
+  static std::shared_ptr<arrow::ArrayBuilder> valueBuilder(int type) {
+    switch (type) {
+      case COLUMN_CHAR: return std::make_shared<arrow::Int8Builder>();
+      case COLUMN_SHORT: return std::make_shared<arrow::Int16Builder>();
+      case COLUMN_INT: return std::make_shared<arrow::Int32Builder>();
+      case COLUMN_LONG: return std::make_shared<arrow::Int64Builder>();
+      default: return std::make_shared<arrow::FloatBuilder>();
+    }
+  }
+
+  template <class B, class T>
+  static arrow::Status append(arrow::ArrayBuilder *builder, Column *column) {
+    std::vector<T> &vec = *reinterpret_cast<std::vector<T> *>(column->address);
+    typedef typename B::value_type value_type;
+    if (column->shape == SHAPE_EVENT) {
+      B *values = static_cast<B *>(builder);
+      if (vec.size() == 0) return values->AppendNull();
+      return values->Append(static_cast<value_type>(vec[0]));
+    }
+    arrow::ListBuilder *list = static_cast<arrow::ListBuilder *>(builder);
+    ARROW_RETURN_NOT_OK(list->Append());
+    B *values = static_cast<B *>(list->value_builder());
+    return values->AppendValues(reinterpret_cast<const value_type *>(vec.data()), vec.size());
+  }
+
+ public:
+  ArrowOutput(ColumnRegistry &registry, TTree *source, const std::string &filename) {
+    std::vector<std::shared_ptr<arrow::Field>> fields;
+    std::vector<Column> &all = registry.getColumns();
+    for (int i = 0; i < all.size(); i++) {
+      if (all[i].tree != source || all[i].type == COLUMN_OTHER) continue;
+      Column *column = &all[i];
+      std::shared_ptr<arrow::DataType> type = dataType(column->type);
+      std::shared_ptr<arrow::ArrayBuilder> values = valueBuilder(column->type);
+      if (column->shape == SHAPE_EVENT) {
+        fields.push_back(arrow::field(column->name, type));
+        builders.push_back(values);
+      } else {
+        fields.push_back(arrow::field(column->name, arrow::list(type)));
+        builders.push_back(std::make_shared<arrow::ListBuilder>(arrow::default_memory_pool(), values));
+      }
+      columns.push_back(column);
+    }
+    schema = arrow::schema(fields);
+
+    arrow::Result<std::shared_ptr<arrow::io::FileOutputStream>> file = arrow::io::FileOutputStream::Open(filename);
+    check(file.status(), "open");
+    stream = *file;
+#ifdef __PARQUET__
+    if (filename.size() > 8 && filename.compare(filename.size() - 8, 8, ".parquet") == 0) {
+      arrow::Result<std::unique_ptr<parquet::arrow::FileWriter>> writer =
+          parquet::arrow::FileWriter::Open(*schema, arrow::default_memory_pool(), stream);
+      check(writer.status(), "parquet writer");
+      parquet = std::move(*writer);
+      return;
+    }
+#endif
+    arrow::Result<std::shared_ptr<arrow::ipc::RecordBatchWriter>> writer = arrow::ipc::MakeFileWriter(stream, schema);
+    check(writer.status(), "ipc writer");
+    ipc = *writer;
+  }
+
+  // Appends the current content of the column vectors as one row
+  void fill() {
+    for (int c = 0; c < columns.size(); c++) {
+      arrow::ArrayBuilder *builder = builders[c].get();
+      switch (columns[c]->type) {
+        case COLUMN_CHAR: check(append<arrow::Int8Builder, Char_t>(builder, columns[c]), "append"); break;
+        case COLUMN_SHORT: check(append<arrow::Int16Builder, Short_t>(builder, columns[c]), "append"); break;
+        case COLUMN_INT: check(append<arrow::Int32Builder, Int_t>(builder, columns[c]), "append"); break;
+        case COLUMN_LONG: check(append<arrow::Int64Builder, Long64_t>(builder, columns[c]), "append"); break;
+        default: check(append<arrow::FloatBuilder, Float_t>(builder, columns[c]), "append"); break;
+      }
+    }
+    rows++;
+  }
+
+  // Writes the rows collected so far as one record batch
+  void flush() {
+    if (rows == 0) return;
+    std::vector<std::shared_ptr<arrow::Array>> arrays(builders.size());
+    for (int c = 0; c < builders.size(); c++) check(builders[c]->Finish(&arrays[c]), "finish");
+    std::shared_ptr<arrow::RecordBatch> batch = arrow::RecordBatch::Make(schema, rows, arrays);
+#ifdef __PARQUET__
+    if (parquet) {
+      arrow::Result<std::shared_ptr<arrow::Table>> table = arrow::Table::FromRecordBatches({batch});
+      check(table.status(), "table");
+      check(parquet->WriteTable(**table, rows), "write");
+      rows = 0;
+      return;
+    }
+#endif
+    check(ipc->WriteRecordBatch(*batch), "write");
+    rows = 0;
+  }
+
+  void close() {
+    flush();
+#ifdef __PARQUET__
+    if (parquet) check(parquet->Close(), "close");
+#endif
+    if (ipc) check(ipc->Close(), "close");
+    bytesWritten = getBytesWritten();
+    check(stream->Close(), "close");
+  }
+
+  long getBytesWritten() {
+    if (stream->closed()) return bytesWritten;
+    arrow::Result<int64_t> position = stream->Tell();
+    return position.ok() ? *position : bytesWritten;
+  }
+};
+
+#else
+
+// Built without Arrow, asking for Arrow output is an error
+class ArrowOutput {
+ public:
+  ArrowOutput(ColumnRegistry &registry, TTree *source, const std::string &filename) {
+    std::cerr << "[ERROR] dst2root was built without Arrow support, can not write " << filename << std::endl;
+    exit(1);
+  }
+  void fill() {}
+  void flush() {}
+  void close() {}
+  long getBytesWritten() { return 0; }
+};
+
+#endif
+
+#endif
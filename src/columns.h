@@ -0,0 +1,271 @@
+/**************************************/
+/*                                    */
+/*  Helpers to move bank columns      */
+/*  into output branches              */
+/*                                    */
+/**************************************/
+
+#ifndef COLUMNS_H_GUARD
+#define COLUMNS_H_GUARD
+
+#include <stdint.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "TTree.h"
+#include "node.h"
+
+// Copies a node into a vector with the same width as the bank type
+// (int8_t -> Char_t, int16_t -> Short_t, int64_t -> Long64_t, ...) in one memcpy.
+template <class T, class S>
+inline void copyNode(hipo::node<S> *node, std::vector<T> &vec) {
+  static_assert(sizeof(T) == sizeof(S), "copyNode needs the output type to have the bank width");
+  int l = node->getLength();
+  vec.resize(l);
+  if (l > 0) memcpy(&vec[0], node->getAddress(), l * sizeof(T));
+}
+
+// Narrows a column that was built in the int join buffers
+// (e.g. sectors with -1 for missing) back to the bank width.
+template <class T, class S>
+inline void narrowCopy(const std::vector<S> &in, std::vector<T> &out) {
+  int l = in.size();
+  out.resize(l);
+  for (int i = 0; i < l; i++) out[i] = in[i];
+}
+
+// Rounds a float to the given number of explicit mantissa bits (0-23),
+// the dropped low bits become zero and compress very well.
+// NaN and infinity are left untouched.
+inline float truncateMantissa(float value, int bits) {
+  if (bits >= 23 || bits < 0) return value;
+  uint32_t word;
+  memcpy(&word, &value, sizeof(word));
+  if ((word & 0x7F800000) == 0x7F800000) return value;
+  int drop = 23 - bits;
+  word += (1u << (drop - 1));
+  word &= ~((1u << drop) - 1);
+  memcpy(&value, &word, sizeof(word));
+  return value;
+}
+
+enum ColumnType { COLUMN_CHAR, COLUMN_SHORT, COLUMN_INT, COLUMN_LONG, COLUMN_FLOAT, COLUMN_OTHER };
+
+inline int columnType(std::vector<Char_t> *) { return COLUMN_CHAR; }
+inline int columnType(std::vector<Short_t> *) { return COLUMN_SHORT; }
+inline int columnType(std::vector<Int_t> *) { return COLUMN_INT; }
+inline int columnType(std::vector<Long64_t> *) { return COLUMN_LONG; }
+inline int columnType(std::vector<Float_t> *) { return COLUMN_FLOAT; }
+template <class T>
+inline int columnType(std::vector<T> *) {
+  return COLUMN_OTHER;
+}
+
+// How a column lines up with REC::Particle rows, used by the flat output
+enum ColumnShape {
+  SHAPE_PARTICLE,  // one row per particle, already aligned by pindex
+  SHAPE_EVENT,     // one value per event (run, event, STTime, ...)
+  SHAPE_ROWS       // rows of some other bank (scalers, MC, CVT tracks)
+};
+
+// Type erased handling of the std::vector<T> behind a column, used to
+// give other threads their own copy of the event (skims)
+template <class T>
+void *createColumn(TTree *tree, const char *name) {
+  std::vector<T> *vec = new std::vector<T>();
+  tree->Branch(name, vec);
+  return vec;
+}
+
+template <class T>
+void saveColumn(void *address, std::vector<char> &buffer) {
+  std::vector<T> &vec = *reinterpret_cast<std::vector<T> *>(address);
+  int n = vec.size();
+  size_t offset = buffer.size();
+  buffer.resize(offset + sizeof(int) + n * sizeof(T));
+  memcpy(&buffer[offset], &n, sizeof(int));
+  if (n > 0) memcpy(&buffer[offset + sizeof(int)], &vec[0], n * sizeof(T));
+}
+
+template <class T>
+const char *loadColumn(void *address, const char *buffer) {
+  std::vector<T> &vec = *reinterpret_cast<std::vector<T> *>(address);
+  int n;
+  memcpy(&n, buffer, sizeof(int));
+  vec.resize(n);
+  if (n > 0) memcpy(&vec[0], buffer + sizeof(int), n * sizeof(T));
+  return buffer + sizeof(int) + n * sizeof(T);
+}
+
+template <class T>
+void deleteColumn(void *address) {
+  delete reinterpret_cast<std::vector<T> *>(address);
+}
+
+struct Column {
+  std::string name;
+  TTree *tree;
+  int type;
+  int shape;
+  void *address;
+  int precision;  // mantissa bits kept for float columns, -1 = full precision
+  void *(*create)(TTree *tree, const char *name);
+  void (*save)(void *address, std::vector<char> &buffer);
+  const char *(*load)(void *address, const char *buffer);
+  void (*destroy)(void *address);
+};
+
+// Keeps track of every output branch by name so that per column
+// settings (precision, ...) can be applied without touching the
+// hand written conversion code.
+class ColumnRegistry {
+ private:
+  std::vector<Column> columns;
+  std::vector<int> truncated;
+  TTree *deferred = NULL;
+
+ public:
+  template <class T>
+  void branch(TTree *tree, const char *name, std::vector<T> *vec, int shape = SHAPE_PARTICLE) {
+    if (tree != deferred) tree->Branch(name, vec);
+    Column column;
+    column.name = name;
+    column.tree = tree;
+    column.type = columnType(vec);
+    column.shape = shape;
+    column.address = vec;
+    column.precision = -1;
+    column.create = createColumn<T>;
+    column.save = saveColumn<T>;
+    column.load = loadColumn<T>;
+    column.destroy = deleteColumn<T>;
+    columns.push_back(column);
+  }
+
+  // Columns declared on this tree are only recorded, not branched,
+  // when the vectors are written through some other layout.
+  void defer(TTree *tree) { deferred = tree; }
+
+  std::vector<Column> &getColumns() { return columns; }
+
+  Column *find(const char *name) {
+    for (int i = 0; i < columns.size(); i++) {
+      if (columns[i].name == name) return &columns[i];
+    }
+    return NULL;
+  }
+
+  // Reads "branch_name  mantissa_bits" lines, '#' starts a comment.
+  void readPrecision(const char *filename) {
+    std::ifstream config(filename);
+    if (!config.is_open()) {
+      std::cerr << "[ERROR] can not open precision file : " << filename << std::endl;
+      exit(1);
+    }
+    std::string line;
+    while (std::getline(config, line)) {
+      std::string::size_type comment = line.find('#');
+      if (comment != std::string::npos) line.erase(comment);
+      std::istringstream tokens(line);
+      std::string name;
+      int bits;
+      if (!(tokens >> name)) continue;
+      if (!(tokens >> bits) || bits < 0 || bits > 23) {
+        std::cerr << "[ERROR] bad precision for branch " << name << " in " << filename << std::endl;
+        exit(1);
+      }
+      Column *column = find(name.c_str());
+      if (column == NULL || column->type != COLUMN_FLOAT) {
+        std::cerr << "[WARNING] precision ignored, " << name << " is not a float output branch" << std::endl;
+        continue;
+      }
+      column->precision = bits;
+    }
+    truncated.clear();
+    for (int i = 0; i < columns.size(); i++) {
+      if (columns[i].precision >= 0) truncated.push_back(i);
+    }
+  }
+
+  // Applied to the event just before TTree::Fill
+  void applyPrecision() {
+    for (int c = 0; c < truncated.size(); c++) {
+      Column &column = columns[truncated[c]];
+      std::vector<float> &vec = *reinterpret_cast<std::vector<float> *>(column.address);
+      for (int i = 0; i < vec.size(); i++) vec[i] = truncateMantissa(vec[i], column.precision);
+    }
+  }
+};
+
+// One tree entry per REC::Particle row. The particle columns of the source
+// tree become scalars taken at the row index, the event columns are repeated
+// from their first row. Columns with rows of other banks and the non numeric
+// ones (the particle 4-vectors, px/py/pz/mass_pid are there already) are left out.
+class FlatTree {
+ private:
+  TTree *tree;
+  std::vector<Column *> columns;
+  std::vector<Long64_t> buffers;  // one 8 byte slot per column
+  Int_t pindex;
+
+  static const char *leafCode(int type) {
+    switch (type) {
+      case COLUMN_CHAR: return "/B";
+      case COLUMN_SHORT: return "/S";
+      case COLUMN_INT: return "/I";
+      case COLUMN_LONG: return "/L";
+      default: return "/F";
+    }
+  }
+
+  template <class T>
+  static void take(Column *column, int row, Long64_t *slot, T missing) {
+    std::vector<T> &vec = *reinterpret_cast<std::vector<T> *>(column->address);
+    T value = (row < vec.size()) ? vec[row] : missing;
+    memcpy(slot, &value, sizeof(T));
+  }
+
+ public:
+  FlatTree(TTree *t, ColumnRegistry &registry, TTree *source) {
+    tree = t;
+    std::vector<Column> &all = registry.getColumns();
+    for (int i = 0; i < all.size(); i++) {
+      if (all[i].tree != source || all[i].shape == SHAPE_ROWS || all[i].type == COLUMN_OTHER) continue;
+      columns.push_back(&all[i]);
+    }
+    buffers.resize(columns.size());
+    tree->Branch("pindex", &pindex, "pindex/I");
+    for (int i = 0; i < columns.size(); i++) {
+      std::string leaf = columns[i]->name + leafCode(columns[i]->type);
+      tree->Branch(columns[i]->name.c_str(), &buffers[i], leaf.c_str());
+    }
+  }
+
+  TTree *getTree() { return tree; }
+
+  void fill(int rows) {
+    for (pindex = 0; pindex < rows; pindex++) {
+      for (int c = 0; c < columns.size(); c++) {
+        Column *column = columns[c];
+        int row = (column->shape == SHAPE_EVENT) ? 0 : pindex;
+        switch (column->type) {
+          case COLUMN_CHAR: take<Char_t>(column, row, &buffers[c], -1); break;
+          case COLUMN_SHORT: take<Short_t>(column, row, &buffers[c], -1); break;
+          case COLUMN_INT: take<Int_t>(column, row, &buffers[c], -1); break;
+          case COLUMN_LONG: take<Long64_t>(column, row, &buffers[c], -1); break;
+          default: take<Float_t>(column, row, &buffers[c], std::nanf("")); break;
+        }
+      }
+      tree->Fill();
+    }
+  }
+};
+
+#endif
@@ -6,23 +6,111 @@
 #include <time.h>
 #include <chrono>
 #include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <vector>
 // ROOT libs
 #include "Math/Vector4D.h"
 #include "TFile.h"
+#include "TROOT.h"
 #include "TTree.h"
 // Hipo libs
+#include "lund.h"
+#include "profiler.h"
 #include "reader.h"
 
+#include "arrowout.h"
 #include "clipp.h"
+#include "columns.h"
 #include "constants.h"
+#include "histograms.h"
+#include "reporter.h"
+#include "skims.h"
 
 #define NaN std::nanf("-9999")
 
+// --lund: the input is a LUND generator file, each event becomes one
+// entry with the columns of the MC::Lund block of a converted -mc file.
+int convertLund(const std::string &InFileName, const std::string &OutFileName, int threads, bool is_batch,
+                const std::string &PrecisionFileName) {
+  text::lund lund;
+  lund.setThreads(threads);
+  if (!lund.open(InFileName.c_str())) exit(1);
+
+  auto start_full = std::chrono::high_resolution_clock::now();
+  TFile *OutputFile = new TFile(OutFileName.c_str(), "RECREATE");
+  OutputFile->SetCompressionSettings(6);
+  TTree *clas12 = new TTree("clas12", "clas12");
+  ColumnRegistry columns;
+
+  std::vector<int> Lund_pid;
+  std::vector<ROOT::Math::XYZTVector> Lund_particle;
+  std::vector<float> Lund_px;
+  std::vector<float> Lund_py;
+  std::vector<float> Lund_pz;
+  std::vector<float> Lund_E;
+  std::vector<float> Lund_vx;
+  std::vector<float> Lund_vy;
+  std::vector<float> Lund_vz;
+  std::vector<float> Lund_ltime;
+  columns.branch(clas12, "lund_pid", &Lund_pid, SHAPE_ROWS);
+  columns.branch(clas12, "lund_particle", &Lund_particle, SHAPE_ROWS);
+  columns.branch(clas12, "lund_px", &Lund_px, SHAPE_ROWS);
+  columns.branch(clas12, "lund_py", &Lund_py, SHAPE_ROWS);
+  columns.branch(clas12, "lund_pz", &Lund_pz, SHAPE_ROWS);
+  columns.branch(clas12, "lund_E", &Lund_E, SHAPE_ROWS);
+  columns.branch(clas12, "lund_vx", &Lund_vx, SHAPE_ROWS);
+  columns.branch(clas12, "lund_vy", &Lund_vy, SHAPE_ROWS);
+  columns.branch(clas12, "lund_vz", &Lund_vz, SHAPE_ROWS);
+  columns.branch(clas12, "lund_ltime", &Lund_ltime, SHAPE_ROWS);
+  if (PrecisionFileName != "") columns.readPrecision(PrecisionFileName.c_str());
+
+  long events = 0;
+  while (lund.next()) {
+    text::lundColumns &c = lund.getColumns();
+    int first = lund.getFirst();
+    int last = first + lund.getRows();
+    Lund_pid.assign(c.pid.begin() + first, c.pid.begin() + last);
+    Lund_px.assign(c.px.begin() + first, c.px.begin() + last);
+    Lund_py.assign(c.py.begin() + first, c.py.begin() + last);
+    Lund_pz.assign(c.pz.begin() + first, c.pz.begin() + last);
+    Lund_E.assign(c.energy.begin() + first, c.energy.begin() + last);
+    Lund_vx.assign(c.vx.begin() + first, c.vx.begin() + last);
+    Lund_vy.assign(c.vy.begin() + first, c.vy.begin() + last);
+    Lund_vz.assign(c.vz.begin() + first, c.vz.begin() + last);
+    Lund_ltime.assign(c.ltime.begin() + first, c.ltime.begin() + last);
+    Lund_particle.resize(last - first);
+    for (int i = 0; i < Lund_particle.size(); i++)
+      Lund_particle[i].SetPxPyPzE(Lund_px[i], Lund_py[i], Lund_pz[i], Lund_E[i]);
+    columns.applyPrecision();
+    clas12->Fill();
+    events++;
+  }
+
+  OutputFile->cd();
+  clas12->Write();
+  OutputFile->Close();
+
+  if (!is_batch) {
+    std::chrono::duration<double> elapsed_full = (std::chrono::high_resolution_clock::now() - start_full);
+    std::cout << "Elapsed time for " << events << " LUND events: " << elapsed_full.count() << " s" << std::endl;
+    std::cout << "Events/Sec: " << events / elapsed_full.count() << " Hz" << std::endl;
+  }
+  return 0;
+}
+
 int main(int argc, char **argv) {
   std::string InFileName = "";
   std::string OutFileName = "";
+  std::string StatsFileName = "";
+  std::string PrecisionFileName = "";
+  std::string SplitMode = "";
+  std::string ArrowFileName = "";
+  std::string HistFileName = "";
+  std::string SkimFileName = "";
+  std::string BanksFileName = "";
+  std::string RequireBanks = "";
   bool is_mc = false;
   bool is_batch = false;
   bool print_help = false;
@@ -30,6 +118,20 @@ int main(int argc, char **argv) {
   bool elec_first = false;
   bool cov = false;
   bool cvt = false;
+  bool profile = false;
+  bool native = false;
+  bool runinfo = false;
+  bool flat = false;
+  bool hist_only = false;
+  bool is_lund = false;
+  bool write_summary = false;
+  int threads = 0;
+  int read_ahead = 0;
+  double follow = -1;
+  long max_events = -1;
+  int prescale = 1;
+  double fraction = 1.0;
+  unsigned long seed = 0;
 
   auto cli =
       (clipp::option("-h", "--help").set(print_help) % "print help",
@@ -39,6 +141,46 @@ int main(int argc, char **argv) {
        clipp::option("-e", "--elec").set(elec_first) % "Only save events with good electron as first particle",
        clipp::option("-c", "--cov").set(cov) % "Save Covariant Matrix for kinematic fitting",
        clipp::option("-cvt", "--CVTDetector").set(cvt) % "Save CVT information for kinematic fitting",
+       clipp::option("-n", "--native").set(native) %
+           "Keep the bank integer widths (Char_t, Short_t) instead of widening to int",
+       clipp::option("-ri", "--runinfo").set(runinfo) %
+           "Write run conditions and scalers once into runinfo/scaler trees instead of every event",
+       clipp::option("-f", "--flat").set(flat) %
+           "One entry per REC::Particle row with scalar branches (particles tree)",
+       (clipp::option("-g", "--generate") & clipp::value("bankHeader", BanksFileName)) %
+           "Write a header with typed accessors for the banks of the input dictionary and exit",
+       clipp::option("-l", "--lund").set(is_lund) % "The input is a LUND text file, write its MC::Lund columns",
+       (clipp::option("-j", "--threads") & clipp::value("threads", threads)) %
+           "Threads for parsing LUND input (0 = all cores)",
+       (clipp::option("--read-ahead") & clipp::value("depth", read_ahead)) %
+           "Keep this many records in flight while reading (io_uring or reader threads)",
+       (clipp::option("--follow") & clipp::value("idleSeconds", follow)) %
+           "Follow an input file that is still being written, stop after idleSeconds without new data (0 = never)",
+       (clipp::option("--max-events") & clipp::value("N", max_events)) %
+           "Convert only the first N events, records are decompressed only as far as needed",
+       (clipp::option("--prescale") & clipp::value("N", prescale)) %
+           "Convert every N-th event, records without one of them are skipped unread",
+       (clipp::option("--fraction") & clipp::value("f", fraction)) %
+           "Convert a random fraction f of the events, sampling whole records first",
+       (clipp::option("--seed") & clipp::value("seed", seed)) % "Seed of the --fraction sampling (default 0)",
+       (clipp::option("--require") & clipp::value("banks", RequireBanks)) %
+           "Only convert events with these banks (comma separated, bank:rows for a minimum row count)",
+       clipp::option("--summary").set(write_summary) %
+           "Write the bank summary (inputFile.hipo.summary) used by --require and -r to skip records, and exit",
+       clipp::option("--profile").set(profile) % "Print per-stage timing breakdown and JSON summary",
+       (clipp::option("-p", "--precision") & clipp::value("precisionFile", PrecisionFileName)) %
+           "Per branch float precision (\"branch mantissa_bits\" per line)",
+       (clipp::option("--split") & clipp::value("trees|files", SplitMode)) %
+           "Write each detector group into its own friend tree (trees) or sidecar file (files)",
+       (clipp::option("-a", "--arrow") & clipp::value("arrowFile", ArrowFileName)) %
+           "Write Arrow IPC (or .parquet) instead of ROOT, one record batch per HIPO record",
+       (clipp::option("-H", "--hist") & clipp::value("histFile", HistFileName)) %
+           "Fill the histograms defined in histFile during the conversion",
+       clipp::option("--hist-only").set(hist_only) % "Only write the histograms, no tree",
+       (clipp::option("-k", "--skims") & clipp::value("skimFile", SkimFileName)) %
+           "Also write the skims (name, output file, cut per line) defined in skimFile",
+       (clipp::option("-s", "--stats") & clipp::value("statsFile", StatsFileName)) %
+           "Write final run statistics to file",
        clipp::value("inputFile.hipo", InFileName), clipp::opt_value("outputFile.root", OutFileName));
 
   clipp::parse(argc, argv, cli);
@@ -47,15 +189,111 @@ int main(int argc, char **argv) {
     exit(0);
   }
 
+  if (OutFileName == "" && InFileName == "-") {
+    std::cerr << "An output file is needed when reading the standard input" << std::endl;
+    exit(1);
+  }
   if (OutFileName == "") OutFileName = InFileName + ".root";
+  if (is_lund) return convertLund(InFileName, OutFileName, threads, is_batch, PrecisionFileName);
+  if (BanksFileName != "") {
+    hipo::reader reader(InFileName.c_str());
+    std::ofstream banks(BanksFileName.c_str());
+    banks << reader.getSchemaDictionary()->getBanksCode();
+    if (!is_batch) std::cout << "Bank accessors for " << InFileName << " written to " << BanksFileName << std::endl;
+    return 0;
+  }
+  if (write_summary) {
+    if (InFileName == "-") {
+      std::cerr << "[ERROR] --summary needs an input file" << std::endl;
+      exit(1);
+    }
+    hipo::reader reader(true);
+    reader.open(InFileName.c_str());
+    hipo::fileSummary summary;
+    summary.build(reader, InFileName.c_str());
+    std::string SummaryFileName = hipo::fileSummary::sidecarName(InFileName.c_str());
+    if (summary.write(SummaryFileName.c_str()) == false) exit(1);
+    if (!is_batch) {
+      summary.show();
+      std::cout << "Bank summary for " << InFileName << " written to " << SummaryFileName << std::endl;
+    }
+    return 0;
+  }
+  if (SplitMode != "" && SplitMode != "trees" && SplitMode != "files") {
+    std::cerr << "[ERROR] --split must be trees or files, not " << SplitMode << std::endl;
+    exit(1);
+  }
+  if (flat && SplitMode != "") {
+    std::cerr << "[ERROR] --flat can not be combined with --split" << std::endl;
+    exit(1);
+  }
+  bool arrow = (ArrowFileName != "");
+  if (hist_only && HistFileName == "") {
+    std::cerr << "[ERROR] --hist-only needs a histogram file (-H)" << std::endl;
+    exit(1);
+  }
+  if (HistFileName != "" && arrow) {
+    std::cerr << "[ERROR] histograms are written to the ROOT output, they can not be combined with --arrow" << std::endl;
+    exit(1);
+  }
+  if (hist_only && (flat || SplitMode != "")) {
+    std::cerr << "[ERROR] --hist-only can not be combined with --flat or --split" << std::endl;
+    exit(1);
+  }
+  if (SkimFileName != "" && SplitMode != "") {
+    std::cerr << "[ERROR] --skims can not be combined with --split" << std::endl;
+    exit(1);
+  }
+  // skim writers fill and write their trees on their own threads
+  if (SkimFileName != "") ROOT::EnableThreadSafety();
+  if (arrow && (flat || runinfo || SplitMode != "")) {
+    std::cerr << "[ERROR] --arrow can not be combined with --flat, --runinfo or --split" << std::endl;
+    exit(1);
+  }
+
+  hipo::profiler::enable(profile);
+  int stage_read = hipo::profiler::addStage("read");
+  // reader->next() does the record reading, decompression and event scanning
+  for (int stage = hipo::profiler::STAGE_IO; stage <= hipo::profiler::STAGE_SCAN; stage++)
+    hipo::profiler::setParent(stage, stage_read);
+  int stage_join = hipo::profiler::addStage("join");
+  int stage_hist = hipo::profiler::addStage("histograms");
+  int stage_skim = hipo::profiler::addStage("skims");
+  int stage_fill = hipo::profiler::addStage("fill");
+  int stage_write = hipo::profiler::addStage("write");
 
   auto start_full = std::chrono::high_resolution_clock::now();
-  TFile *OutputFile = new TFile(OutFileName.c_str(), "RECREATE");
-  OutputFile->SetCompressionSettings(6);
+  TFile *OutputFile = NULL;
+  if (!arrow) {
+    OutputFile = new TFile(OutFileName.c_str(), "RECREATE");
+    OutputFile->SetCompressionSettings(6);
+  }
 
   TTree *clas12 = new TTree("clas12", "clas12");
-  hipo::reader *reader = new hipo::reader(InFileName.c_str());
-  int tot_hipo_events = reader->numEvents();
+  ColumnRegistry columns;
+  if (flat || arrow || hist_only) columns.defer(clas12);
+  hipo::reader *reader = new hipo::reader();
+  reader->setReadAhead(read_ahead);
+  if (follow >= 0) reader->setFollow(follow);
+  reader->setMaxEvents(max_events);
+  reader->setPrescale(prescale);
+  if (fraction < 1.0) reader->setFraction(fraction, seed);
+  reader->open(InFileName.c_str());
+  // events without particles are dropped below, the summary can skip whole records of them
+  if (good_rec) reader->requireBank(331);
+  std::stringstream required(RequireBanks);
+  std::string bank;
+  while (std::getline(required, bank, ',')) {
+    int rows = 1;
+    // bank names have "::" in them, the row count follows a single ':'
+    size_t colon = bank.rfind(':');
+    if (colon != std::string::npos && colon > 0 && bank[colon - 1] != ':') {
+      rows = atoi(bank.substr(colon + 1).c_str());
+      bank = bank.substr(0, colon);
+    }
+    if (bank != "" && reader->requireBank(bank.c_str(), rows) == false) exit(1);
+  }
+  ProgressReporter reporter(reader, !is_batch);
 
   hipo::node<int32_t> *run_node = reader->getBranch<int32_t>(11, 1);
   hipo::node<int32_t> *event_node = reader->getBranch<int32_t>(11, 2);
@@ -213,7 +451,7 @@ int main(int argc, char **argv) {
   std::vector<int> NEVENT;
   std::vector<float> EVNTime;
   std::vector<int> TYPE;
-  std::vector<int> TRG;
+  std::vector<Long64_t> TRG;
   std::vector<float> BCG;
   std::vector<float> STTime;
   std::vector<float> RFTime;
@@ -441,198 +679,373 @@ int main(int argc, char **argv) {
   std::vector<float> cvt_CovMat_z02;
   std::vector<float> cvt_CovMat_tandip2;
 
-  clas12->Branch("run", &run);
-  clas12->Branch("event", &event);
-  clas12->Branch("torus", &torus);
-  clas12->Branch("solenoid", &solenoid);
-  clas12->Branch("crate", &crate);
-  clas12->Branch("slot", &slot);
-  clas12->Branch("channel", &channel);
-  clas12->Branch("helicity", &helicity);
-  clas12->Branch("quartet", &quartet);
-  clas12->Branch("value", &value);
-  clas12->Branch("STTime", &STTime);
-  clas12->Branch("RFTime", &RFTime);
-
-  clas12->Branch("pid", &pid);
-  clas12->Branch("particle", &particle);
-  clas12->Branch("p", &p);
-  clas12->Branch("p2", &p2);
-  clas12->Branch("px", &px);
-  clas12->Branch("py", &py);
-  clas12->Branch("pz", &pz);
-  clas12->Branch("vx", &vx);
-  clas12->Branch("vy", &vy);
-  clas12->Branch("vz", &vz);
-  clas12->Branch("mass_pid", &mass);
-  clas12->Branch("energy_pid", &energy);
-  clas12->Branch("charge", &charge);
-  clas12->Branch("beta", &beta);
-  clas12->Branch("chi2pid", &chi2pid);
-  clas12->Branch("status", &status);
+  // Bank width columns, branched instead of the int vectors with --native
+  std::vector<Char_t> crate_native;
+  std::vector<Char_t> slot_native;
+  std::vector<Short_t> channel_native;
+  std::vector<Char_t> helicity_native;
+  std::vector<Char_t> quartet_native;
+  std::vector<Char_t> charge_native;
+  std::vector<Short_t> status_native;
+  std::vector<Char_t> ec_pcal_sec_native;
+  std::vector<Char_t> ec_ecin_sec_native;
+  std::vector<Char_t> ec_ecout_sec_native;
+  std::vector<Char_t> dc_sector_native;
+  std::vector<Char_t> cc_ltcc_sec_native;
+  std::vector<Char_t> cc_htcc_sec_native;
+  std::vector<Char_t> sc_ftof_sec_native;
+  std::vector<Short_t> cvt_pid_native;
+  std::vector<Char_t> cvt_q_native;
+
+  // With --split every detector group gets its own tree, filled in lockstep with
+  // clas12 so that entry i is the same event everywhere. Each one also carries the
+  // event number to cross check the alignment. With "trees" they are friends of
+  // clas12 in the same file, with "files" they go to <output>_<group>.root.
+  std::vector<TTree *> split_trees;
+  std::vector<TFile *> split_files;
+  auto detector_tree = [&](const char *name) -> TTree * {
+    if (SplitMode == "") return clas12;
+    TFile *file = OutputFile;
+    if (SplitMode == "files") {
+      std::string sidecar = OutFileName;
+      std::string::size_type dot = sidecar.rfind(".root");
+      if (dot != std::string::npos) sidecar.erase(dot);
+      sidecar += std::string("_") + name + ".root";
+      file = new TFile(sidecar.c_str(), "RECREATE");
+      file->SetCompressionSettings(6);
+      split_files.push_back(file);
+    }
+    file->cd();
+    TTree *tree = new TTree(name, name);
+    tree->Branch("event", &event);
+    if (SplitMode == "trees") clas12->AddFriend(tree);
+    split_trees.push_back(tree);
+    OutputFile->cd();
+    return tree;
+  };
+
+  // With --runinfo the run conditions only go to the runinfo tree, one entry per
+  // change of (run, torus, solenoid) with the event and clas12 entry range it covers.
+  // The scaler rows go to a sparse scaler tree keyed by the clas12 entry.
+  TTree *runinfo_tree = NULL;
+  TTree *scaler_tree = clas12;
+  int ri_run = 0;
+  float ri_torus = 0;
+  float ri_solenoid = 0;
+  int ri_first_event = 0;
+  int ri_last_event = 0;
+  Long64_t ri_first_entry = 0;
+  Long64_t ri_last_entry = 0;
+  bool ri_open = false;
+  Long64_t scaler_entry = 0;
+  int scaler_event = 0;
+  if (runinfo) {
+    runinfo_tree = new TTree("runinfo", "runinfo");
+    runinfo_tree->Branch("run", &ri_run, "run/I");
+    runinfo_tree->Branch("torus", &ri_torus, "torus/F");
+    runinfo_tree->Branch("solenoid", &ri_solenoid, "solenoid/F");
+    runinfo_tree->Branch("first_event", &ri_first_event, "first_event/I");
+    runinfo_tree->Branch("last_event", &ri_last_event, "last_event/I");
+    runinfo_tree->Branch("first_entry", &ri_first_entry, "first_entry/L");
+    runinfo_tree->Branch("last_entry", &ri_last_entry, "last_entry/L");
+    scaler_tree = new TTree("scaler", "scaler");
+    scaler_tree->Branch("entry", &scaler_entry, "entry/L");
+    scaler_tree->Branch("event", &scaler_event, "event/I");
+  } else {
+    columns.branch(clas12, "run", &run, SHAPE_EVENT);
+  }
+  columns.branch(clas12, "event", &event, SHAPE_EVENT);
+  if (!runinfo) {
+    columns.branch(clas12, "torus", &torus, SHAPE_EVENT);
+    columns.branch(clas12, "solenoid", &solenoid, SHAPE_EVENT);
+  }
+  if (native) {
+    columns.branch(scaler_tree, "crate", &crate_native, SHAPE_ROWS);
+    columns.branch(scaler_tree, "slot", &slot_native, SHAPE_ROWS);
+    columns.branch(scaler_tree, "channel", &channel_native, SHAPE_ROWS);
+    columns.branch(scaler_tree, "helicity", &helicity_native, SHAPE_ROWS);
+    columns.branch(scaler_tree, "quartet", &quartet_native, SHAPE_ROWS);
+  } else {
+    columns.branch(scaler_tree, "crate", &crate, SHAPE_ROWS);
+    columns.branch(scaler_tree, "slot", &slot, SHAPE_ROWS);
+    columns.branch(scaler_tree, "channel", &channel, SHAPE_ROWS);
+    columns.branch(scaler_tree, "helicity", &helicity, SHAPE_ROWS);
+    columns.branch(scaler_tree, "quartet", &quartet, SHAPE_ROWS);
+  }
+  columns.branch(scaler_tree, "value", &value, SHAPE_ROWS);
+  columns.branch(clas12, "TRG", &TRG, SHAPE_EVENT);
+  columns.branch(clas12, "STTime", &STTime, SHAPE_EVENT);
+  columns.branch(clas12, "RFTime", &RFTime, SHAPE_EVENT);
+
+  columns.branch(clas12, "pid", &pid);
+  columns.branch(clas12, "particle", &particle);
+  columns.branch(clas12, "p", &p);
+  columns.branch(clas12, "p2", &p2);
+  columns.branch(clas12, "px", &px);
+  columns.branch(clas12, "py", &py);
+  columns.branch(clas12, "pz", &pz);
+  columns.branch(clas12, "vx", &vx);
+  columns.branch(clas12, "vy", &vy);
+  columns.branch(clas12, "vz", &vz);
+  columns.branch(clas12, "mass_pid", &mass);
+  columns.branch(clas12, "energy_pid", &energy);
+  if (native)
+    columns.branch(clas12, "charge", &charge_native);
+  else
+    columns.branch(clas12, "charge", &charge);
+  columns.branch(clas12, "beta", &beta);
+  columns.branch(clas12, "chi2pid", &chi2pid);
+  if (native)
+    columns.branch(clas12, "status", &status_native);
+  else
+    columns.branch(clas12, "status", &status);
   
   if (cov) {
-    clas12->Branch("CovMat_11", &CovMat_11);
-    clas12->Branch("CovMat_12", &CovMat_12);
-    clas12->Branch("CovMat_13", &CovMat_13);
-    clas12->Branch("CovMat_14", &CovMat_14);
-    clas12->Branch("CovMat_15", &CovMat_15);
-    clas12->Branch("CovMat_22", &CovMat_22);
-    clas12->Branch("CovMat_23", &CovMat_23);
-    clas12->Branch("CovMat_24", &CovMat_24);
-    clas12->Branch("CovMat_25", &CovMat_25);
-    clas12->Branch("CovMat_33", &CovMat_33);
-    clas12->Branch("CovMat_34", &CovMat_34);
-    clas12->Branch("CovMat_35", &CovMat_35);
-    clas12->Branch("CovMat_44", &CovMat_44);
-    clas12->Branch("CovMat_45", &CovMat_45);
-    clas12->Branch("CovMat_55", &CovMat_55);
+    TTree *cov_tree = detector_tree("cov");
+    columns.branch(cov_tree, "CovMat_11", &CovMat_11);
+    columns.branch(cov_tree, "CovMat_12", &CovMat_12);
+    columns.branch(cov_tree, "CovMat_13", &CovMat_13);
+    columns.branch(cov_tree, "CovMat_14", &CovMat_14);
+    columns.branch(cov_tree, "CovMat_15", &CovMat_15);
+    columns.branch(cov_tree, "CovMat_22", &CovMat_22);
+    columns.branch(cov_tree, "CovMat_23", &CovMat_23);
+    columns.branch(cov_tree, "CovMat_24", &CovMat_24);
+    columns.branch(cov_tree, "CovMat_25", &CovMat_25);
+    columns.branch(cov_tree, "CovMat_33", &CovMat_33);
+    columns.branch(cov_tree, "CovMat_34", &CovMat_34);
+    columns.branch(cov_tree, "CovMat_35", &CovMat_35);
+    columns.branch(cov_tree, "CovMat_44", &CovMat_44);
+    columns.branch(cov_tree, "CovMat_45", &CovMat_45);
+    columns.branch(cov_tree, "CovMat_55", &CovMat_55);
   }
   if( cvt ){
-    clas12->Branch("cvt_pid",&cvt_pid);
-    clas12->Branch("cvt_q",&cvt_q);
-    clas12->Branch("cvt_p",&cvt_p);
-    clas12->Branch("cvt_pt",&cvt_pt);
-    clas12->Branch("cvt_phi0",&cvt_phi0);
-    clas12->Branch("cvt_tandip",&cvt_tandip);
-    clas12->Branch("cvt_z0",&cvt_z0);
-    clas12->Branch("cvt_d0",&cvt_d0);
-    clas12->Branch("cvt_CovMat_d02",&cvt_CovMat_d02);
-    clas12->Branch("cvt_CovMat_d0rho",&cvt_CovMat_d0rho);
-    clas12->Branch("cvt_CovMat_phi02",&cvt_CovMat_phi02);
-    clas12->Branch("cvt_CovMat_phi0rho",&cvt_CovMat_phi0rho);
-    clas12->Branch("cvt_CovMat_rho2",&cvt_CovMat_rho2);
-    clas12->Branch("cvt_CovMat_z02",&cvt_CovMat_z02);
-    clas12->Branch("cvt_CovMat_tandip2",&cvt_CovMat_tandip2);    
+    TTree *cvt_tree = detector_tree("cvt");
+    if (native) {
+      columns.branch(cvt_tree, "cvt_pid", &cvt_pid_native, SHAPE_ROWS);
+      columns.branch(cvt_tree, "cvt_q", &cvt_q_native, SHAPE_ROWS);
+    } else {
+      columns.branch(cvt_tree, "cvt_pid", &cvt_pid, SHAPE_ROWS);
+      columns.branch(cvt_tree, "cvt_q", &cvt_q, SHAPE_ROWS);
+    }
+    columns.branch(cvt_tree, "cvt_p", &cvt_p, SHAPE_ROWS);
+    columns.branch(cvt_tree, "cvt_pt", &cvt_pt, SHAPE_ROWS);
+    columns.branch(cvt_tree, "cvt_phi0", &cvt_phi0, SHAPE_ROWS);
+    columns.branch(cvt_tree, "cvt_tandip", &cvt_tandip, SHAPE_ROWS);
+    columns.branch(cvt_tree, "cvt_z0", &cvt_z0, SHAPE_ROWS);
+    columns.branch(cvt_tree, "cvt_d0", &cvt_d0, SHAPE_ROWS);
+    columns.branch(cvt_tree, "cvt_CovMat_d02", &cvt_CovMat_d02, SHAPE_ROWS);
+    columns.branch(cvt_tree, "cvt_CovMat_d0rho", &cvt_CovMat_d0rho, SHAPE_ROWS);
+    columns.branch(cvt_tree, "cvt_CovMat_phi02", &cvt_CovMat_phi02, SHAPE_ROWS);
+    columns.branch(cvt_tree, "cvt_CovMat_phi0rho", &cvt_CovMat_phi0rho, SHAPE_ROWS);
+    columns.branch(cvt_tree, "cvt_CovMat_rho2", &cvt_CovMat_rho2, SHAPE_ROWS);
+    columns.branch(cvt_tree, "cvt_CovMat_z02", &cvt_CovMat_z02, SHAPE_ROWS);
+    columns.branch(cvt_tree, "cvt_CovMat_tandip2", &cvt_CovMat_tandip2, SHAPE_ROWS);    
   }
   if (is_mc) {
-    clas12->Branch("mc_pid", &MC_pid);
-    clas12->Branch("mc_px", &MC_px);
-    clas12->Branch("mc_py", &MC_py);
-    clas12->Branch("mc_pz", &MC_pz);
-    clas12->Branch("mc_vx", &MC_vx);
-    clas12->Branch("mc_vy", &MC_vy);
-    clas12->Branch("mc_vz", &MC_vz);
-    clas12->Branch("mc_vt", &MC_vt);
-    clas12->Branch("mc_helicity", &MC_helicity);
-
-    clas12->Branch("lund_pid", &Lund_pid);
-    clas12->Branch("lund_particle", &Lund_particle);
-    clas12->Branch("lund_px", &Lund_px);
-    clas12->Branch("lund_py", &Lund_py);
-    clas12->Branch("lund_pz", &Lund_pz);
-    clas12->Branch("lund_E", &Lund_E);
-    clas12->Branch("lund_vx", &Lund_vx);
-    clas12->Branch("lund_vy", &Lund_vy);
-    clas12->Branch("lund_vz", &Lund_vz);
-    clas12->Branch("lund_ltime", &Lund_ltime);
+    TTree *mc_tree = detector_tree("mc");
+    columns.branch(mc_tree, "mc_pid", &MC_pid, SHAPE_ROWS);
+    columns.branch(mc_tree, "mc_px", &MC_px, SHAPE_ROWS);
+    columns.branch(mc_tree, "mc_py", &MC_py, SHAPE_ROWS);
+    columns.branch(mc_tree, "mc_pz", &MC_pz, SHAPE_ROWS);
+    columns.branch(mc_tree, "mc_vx", &MC_vx, SHAPE_ROWS);
+    columns.branch(mc_tree, "mc_vy", &MC_vy, SHAPE_ROWS);
+    columns.branch(mc_tree, "mc_vz", &MC_vz, SHAPE_ROWS);
+    columns.branch(mc_tree, "mc_vt", &MC_vt, SHAPE_ROWS);
+    columns.branch(mc_tree, "mc_helicity", &MC_helicity, SHAPE_ROWS);
+
+    columns.branch(mc_tree, "lund_pid", &Lund_pid, SHAPE_ROWS);
+    columns.branch(mc_tree, "lund_particle", &Lund_particle, SHAPE_ROWS);
+    columns.branch(mc_tree, "lund_px", &Lund_px, SHAPE_ROWS);
+    columns.branch(mc_tree, "lund_py", &Lund_py, SHAPE_ROWS);
+    columns.branch(mc_tree, "lund_pz", &Lund_pz, SHAPE_ROWS);
+    columns.branch(mc_tree, "lund_E", &Lund_E, SHAPE_ROWS);
+    columns.branch(mc_tree, "lund_vx", &Lund_vx, SHAPE_ROWS);
+    columns.branch(mc_tree, "lund_vy", &Lund_vy, SHAPE_ROWS);
+    columns.branch(mc_tree, "lund_vz", &Lund_vz, SHAPE_ROWS);
+    columns.branch(mc_tree, "lund_ltime", &Lund_ltime, SHAPE_ROWS);
+  }
+
+  TTree *ec_tree = detector_tree("ec");
+  columns.branch(ec_tree, "ec_tot_energy", &ec_tot_energy);
+  columns.branch(ec_tree, "ec_pcal_energy", &ec_pcal_energy);
+  if (native)
+    columns.branch(ec_tree, "ec_pcal_sec", &ec_pcal_sec_native);
+  else
+    columns.branch(ec_tree, "ec_pcal_sec", &ec_pcal_sec);
+  columns.branch(ec_tree, "ec_pcal_time", &ec_pcal_time);
+  columns.branch(ec_tree, "ec_pcal_path", &ec_pcal_path);
+  columns.branch(ec_tree, "ec_pcal_x", &ec_pcal_x);
+  columns.branch(ec_tree, "ec_pcal_y", &ec_pcal_y);
+  columns.branch(ec_tree, "ec_pcal_z", &ec_pcal_z);
+  columns.branch(ec_tree, "ec_pcal_lu", &ec_pcal_lu);
+  columns.branch(ec_tree, "ec_pcal_lv", &ec_pcal_lv);
+  columns.branch(ec_tree, "ec_pcal_lw", &ec_pcal_lw);
+
+  columns.branch(ec_tree, "ec_ecin_energy", &ec_ecin_energy);
+  if (native)
+    columns.branch(ec_tree, "ec_ecin_sec", &ec_ecin_sec_native);
+  else
+    columns.branch(ec_tree, "ec_ecin_sec", &ec_ecin_sec);
+  columns.branch(ec_tree, "ec_ecin_time", &ec_ecin_time);
+  columns.branch(ec_tree, "ec_ecin_path", &ec_ecin_path);
+  columns.branch(ec_tree, "ec_ecin_x", &ec_ecin_x);
+  columns.branch(ec_tree, "ec_ecin_y", &ec_ecin_y);
+  columns.branch(ec_tree, "ec_ecin_z", &ec_ecin_z);
+  columns.branch(ec_tree, "ec_ecin_lu", &ec_ecin_lu);
+  columns.branch(ec_tree, "ec_ecin_lv", &ec_ecin_lv);
+  columns.branch(ec_tree, "ec_ecin_lw", &ec_ecin_lw);
+
+  columns.branch(ec_tree, "ec_ecout_energy", &ec_ecout_energy);
+  if (native)
+    columns.branch(ec_tree, "ec_ecout_sec", &ec_ecout_sec_native);
+  else
+    columns.branch(ec_tree, "ec_ecout_sec", &ec_ecout_sec);
+  columns.branch(ec_tree, "ec_ecout_time", &ec_ecout_time);
+  columns.branch(ec_tree, "ec_ecout_path", &ec_ecout_path);
+  columns.branch(ec_tree, "ec_ecout_x", &ec_ecout_x);
+  columns.branch(ec_tree, "ec_ecout_y", &ec_ecout_y);
+  columns.branch(ec_tree, "ec_ecout_z", &ec_ecout_z);
+  columns.branch(ec_tree, "ec_ecout_lu", &ec_ecout_lu);
+  columns.branch(ec_tree, "ec_ecout_lv", &ec_ecout_lv);
+  columns.branch(ec_tree, "ec_ecout_lw", &ec_ecout_lw);
+
+  TTree *track_tree = detector_tree("track");
+  if (native)
+    columns.branch(track_tree, "dc_sector", &dc_sector_native);
+  else
+    columns.branch(track_tree, "dc_sector", &dc_sector);
+  columns.branch(track_tree, "dc_px", &dc_px);
+  columns.branch(track_tree, "dc_py", &dc_py);
+  columns.branch(track_tree, "dc_pz", &dc_pz);
+  columns.branch(track_tree, "dc_vx", &dc_vx);
+  columns.branch(track_tree, "dc_vy", &dc_vy);
+  columns.branch(track_tree, "dc_vz", &dc_vz);
+
+  columns.branch(track_tree, "cvt_px", &cvt_px);
+  columns.branch(track_tree, "cvt_py", &cvt_py);
+  columns.branch(track_tree, "cvt_pz", &cvt_pz);
+  columns.branch(track_tree, "cvt_vx", &cvt_vx);
+  columns.branch(track_tree, "cvt_vy", &cvt_vy);
+  columns.branch(track_tree, "cvt_vz", &cvt_vz);
+
+  TTree *cc_tree = detector_tree("cc");
+  columns.branch(cc_tree, "cc_nphe_tot", &cc_nphe_tot);
+  if (native)
+    columns.branch(cc_tree, "cc_ltcc_sec", &cc_ltcc_sec_native);
+  else
+    columns.branch(cc_tree, "cc_ltcc_sec", &cc_ltcc_sec);
+  columns.branch(cc_tree, "cc_ltcc_nphe", &cc_ltcc_nphe);
+  columns.branch(cc_tree, "cc_ltcc_time", &cc_ltcc_time);
+  columns.branch(cc_tree, "cc_ltcc_path", &cc_ltcc_path);
+  columns.branch(cc_tree, "cc_ltcc_theta", &cc_ltcc_theta);
+  columns.branch(cc_tree, "cc_ltcc_phi", &cc_ltcc_phi);
+
+  if (native)
+    columns.branch(cc_tree, "cc_htcc_sec", &cc_htcc_sec_native);
+  else
+    columns.branch(cc_tree, "cc_htcc_sec", &cc_htcc_sec);
+  columns.branch(cc_tree, "cc_htcc_nphe", &cc_htcc_nphe);
+  columns.branch(cc_tree, "cc_htcc_time", &cc_htcc_time);
+  columns.branch(cc_tree, "cc_htcc_path", &cc_htcc_path);
+  columns.branch(cc_tree, "cc_htcc_theta", &cc_htcc_theta);
+  columns.branch(cc_tree, "cc_htcc_phi", &cc_htcc_phi);
+
+  TTree *sc_tree = detector_tree("sc");
+  if (native)
+    columns.branch(sc_tree, "sc_ftof_sec", &sc_ftof_sec_native);
+  else
+    columns.branch(sc_tree, "sc_ftof_sec", &sc_ftof_sec);
+  columns.branch(sc_tree, "sc_ftof_time", &sc_ftof_time);
+  columns.branch(sc_tree, "sc_ftof_path", &sc_ftof_path);
+  columns.branch(sc_tree, "sc_ftof_layer", &sc_ftof_layer);
+
+  columns.branch(sc_tree, "sc_ftof_energy", &sc_ftof_energy);
+  columns.branch(sc_tree, "sc_ctof_time", &sc_ctof_time);
+  columns.branch(sc_tree, "sc_ctof_path", &sc_ctof_path);
+  columns.branch(sc_tree, "sc_ctof_energy", &sc_ctof_energy);
+
+  TTree *ft_tree = detector_tree("ft");
+  columns.branch(ft_tree, "ft_cal_energy", &ft_cal_energy);
+  columns.branch(ft_tree, "ft_cal_time", &ft_cal_time);
+  columns.branch(ft_tree, "ft_cal_path", &ft_cal_path);
+  columns.branch(ft_tree, "ft_cal_x", &ft_cal_x);
+  columns.branch(ft_tree, "ft_cal_y", &ft_cal_y);
+  columns.branch(ft_tree, "ft_cal_z", &ft_cal_z);
+  columns.branch(ft_tree, "ft_cal_dx", &ft_cal_dx);
+  columns.branch(ft_tree, "ft_cal_dy", &ft_cal_dy);
+  columns.branch(ft_tree, "ft_cal_radius", &ft_cal_radius);
+
+  columns.branch(ft_tree, "ft_hodo_energy", &ft_hodo_energy);
+  columns.branch(ft_tree, "ft_hodo_time", &ft_hodo_time);
+  columns.branch(ft_tree, "ft_hodo_path", &ft_hodo_path);
+  columns.branch(ft_tree, "ft_hodo_x", &ft_hodo_x);
+  columns.branch(ft_tree, "ft_hodo_y", &ft_hodo_y);
+  columns.branch(ft_tree, "ft_hodo_z", &ft_hodo_z);
+  columns.branch(ft_tree, "ft_hodo_dx", &ft_hodo_dx);
+  columns.branch(ft_tree, "ft_hodo_dy", &ft_hodo_dy);
+  columns.branch(ft_tree, "ft_hodo_radius", &ft_hodo_radius);
+
+  if (PrecisionFileName != "") columns.readPrecision(PrecisionFileName.c_str());
+
+  HistogramSet histograms;
+  if (HistFileName != "") histograms.readConfig(HistFileName.c_str(), columns);
+
+  SkimSet skims;
+  if (SkimFileName != "") {
+    skims.readConfig(SkimFileName.c_str(), columns, clas12);
+    skims.start();
   }
 
-  clas12->Branch("ec_tot_energy", &ec_tot_energy);
-  clas12->Branch("ec_pcal_energy", &ec_pcal_energy);
-  clas12->Branch("ec_pcal_sec", &ec_pcal_sec);
-  clas12->Branch("ec_pcal_time", &ec_pcal_time);
-  clas12->Branch("ec_pcal_path", &ec_pcal_path);
-  clas12->Branch("ec_pcal_x", &ec_pcal_x);
-  clas12->Branch("ec_pcal_y", &ec_pcal_y);
-  clas12->Branch("ec_pcal_z", &ec_pcal_z);
-  clas12->Branch("ec_pcal_lu", &ec_pcal_lu);
-  clas12->Branch("ec_pcal_lv", &ec_pcal_lv);
-  clas12->Branch("ec_pcal_lw", &ec_pcal_lw);
-
-  clas12->Branch("ec_ecin_energy", &ec_ecin_energy);
-  clas12->Branch("ec_ecin_sec", &ec_ecin_sec);
-  clas12->Branch("ec_ecin_time", &ec_ecin_time);
-  clas12->Branch("ec_ecin_path", &ec_ecin_path);
-  clas12->Branch("ec_ecin_x", &ec_ecin_x);
-  clas12->Branch("ec_ecin_y", &ec_ecin_y);
-  clas12->Branch("ec_ecin_z", &ec_ecin_z);
-  clas12->Branch("ec_ecin_lu", &ec_ecin_lu);
-  clas12->Branch("ec_ecin_lv", &ec_ecin_lv);
-  clas12->Branch("ec_ecin_lw", &ec_ecin_lw);
-
-  clas12->Branch("ec_ecout_energy", &ec_ecout_energy);
-  clas12->Branch("ec_ecout_sec", &ec_ecout_sec);
-  clas12->Branch("ec_ecout_time", &ec_ecout_time);
-  clas12->Branch("ec_ecout_path", &ec_ecout_path);
-  clas12->Branch("ec_ecout_x", &ec_ecout_x);
-  clas12->Branch("ec_ecout_y", &ec_ecout_y);
-  clas12->Branch("ec_ecout_z", &ec_ecout_z);
-  clas12->Branch("ec_ecout_lu", &ec_ecout_lu);
-  clas12->Branch("ec_ecout_lv", &ec_ecout_lv);
-  clas12->Branch("ec_ecout_lw", &ec_ecout_lw);
-
-  clas12->Branch("dc_sector", &dc_sector);
-  clas12->Branch("dc_px", &dc_px);
-  clas12->Branch("dc_py", &dc_py);
-  clas12->Branch("dc_pz", &dc_pz);
-  clas12->Branch("dc_vx", &dc_vx);
-  clas12->Branch("dc_vy", &dc_vy);
-  clas12->Branch("dc_vz", &dc_vz);
-
-  clas12->Branch("cvt_px", &cvt_px);
-  clas12->Branch("cvt_py", &cvt_py);
-  clas12->Branch("cvt_pz", &cvt_pz);
-  clas12->Branch("cvt_vx", &cvt_vx);
-  clas12->Branch("cvt_vy", &cvt_vy);
-  clas12->Branch("cvt_vz", &cvt_vz);
-
-  clas12->Branch("cc_nphe_tot", &cc_nphe_tot);
-  clas12->Branch("cc_ltcc_sec", &cc_ltcc_sec);
-  clas12->Branch("cc_ltcc_nphe", &cc_ltcc_nphe);
-  clas12->Branch("cc_ltcc_time", &cc_ltcc_time);
-  clas12->Branch("cc_ltcc_path", &cc_ltcc_path);
-  clas12->Branch("cc_ltcc_theta", &cc_ltcc_theta);
-  clas12->Branch("cc_ltcc_phi", &cc_ltcc_phi);
-
-  clas12->Branch("cc_htcc_sec", &cc_htcc_sec);
-  clas12->Branch("cc_htcc_nphe", &cc_htcc_nphe);
-  clas12->Branch("cc_htcc_time", &cc_htcc_time);
-  clas12->Branch("cc_htcc_path", &cc_htcc_path);
-  clas12->Branch("cc_htcc_theta", &cc_htcc_theta);
-  clas12->Branch("cc_htcc_phi", &cc_htcc_phi);
-
-  clas12->Branch("sc_ftof_sec", &sc_ftof_sec);
-  clas12->Branch("sc_ftof_time", &sc_ftof_time);
-  clas12->Branch("sc_ftof_path", &sc_ftof_path);
-  clas12->Branch("sc_ftof_layer", &sc_ftof_layer);
-
-  clas12->Branch("sc_ftof_energy", &sc_ftof_energy);
-  clas12->Branch("sc_ctof_time", &sc_ctof_time);
-  clas12->Branch("sc_ctof_path", &sc_ctof_path);
-  clas12->Branch("sc_ctof_energy", &sc_ctof_energy);
-
-  clas12->Branch("ft_cal_energy", &ft_cal_energy);
-  clas12->Branch("ft_cal_time", &ft_cal_time);
-  clas12->Branch("ft_cal_path", &ft_cal_path);
-  clas12->Branch("ft_cal_x", &ft_cal_x);
-  clas12->Branch("ft_cal_y", &ft_cal_y);
-  clas12->Branch("ft_cal_z", &ft_cal_z);
-  clas12->Branch("ft_cal_dx", &ft_cal_dx);
-  clas12->Branch("ft_cal_dy", &ft_cal_dy);
-  clas12->Branch("ft_cal_radius", &ft_cal_radius);
-
-  clas12->Branch("ft_hodo_energy", &ft_hodo_energy);
-  clas12->Branch("ft_hodo_time", &ft_hodo_time);
-  clas12->Branch("ft_hodo_path", &ft_hodo_path);
-  clas12->Branch("ft_hodo_x", &ft_hodo_x);
-  clas12->Branch("ft_hodo_y", &ft_hodo_y);
-  clas12->Branch("ft_hodo_z", &ft_hodo_z);
-  clas12->Branch("ft_hodo_dx", &ft_hodo_dx);
-  clas12->Branch("ft_hodo_dy", &ft_hodo_dy);
-  clas12->Branch("ft_hodo_radius", &ft_hodo_radius);
-
-  int entry = 0;
+  FlatTree *particles = NULL;
+  if (flat) particles = new FlatTree(new TTree("particles", "particles"), columns, clas12);
+  ArrowOutput *arrow_output = NULL;
+  if (arrow) arrow_output = new ArrowOutput(columns, clas12, ArrowFileName);
+  long batch_position = 0;
+
+  long entry = 0;
+  long written = 0;
   int l = 0;
   int len_pid = 0;
   int len_pindex = 0;
-  while (reader->next() == true) {
-    // entry++;
-    if (!is_batch && (++entry % 1000) == 0)
-      std::cout << "\t" << int(100 * entry / tot_hipo_events) << "%\r\r" << std::flush;
+
+  // When following a file the trees are saved whenever the reader catches up
+  // with the writer and every 10 s, so the output can be read while it grows.
+  long flushed = 0;
+  std::chrono::steady_clock::time_point flush_time = std::chrono::steady_clock::now();
+  auto flush_output = [&]() {
+    flush_time = std::chrono::steady_clock::now();
+    if (written == flushed) return;
+    flushed = written;
+    if (arrow) {
+      arrow_output->flush();
+      return;
+    }
+    if (flat)
+      particles->getTree()->AutoSave("SaveSelf");
+    else if (!hist_only)
+      clas12->AutoSave("SaveSelf");
+    for (int t = 0; t < split_trees.size(); t++) split_trees[t]->AutoSave("SaveSelf");
+    if (runinfo) {
+      runinfo_tree->AutoSave("SaveSelf");
+      scaler_tree->AutoSave("SaveSelf");
+    }
+  };
+  if (follow >= 0) reader->setFollowWait(flush_output);
+  reporter.start();
+  while (true) {
+    hipo::profiler::resume(stage_read);
+    bool has_next = reader->next();
+    hipo::profiler::pause(stage_read, 0, has_next ? 1 : 0);
+    if (!has_next) break;
+    entry++;
+    if (arrow && reader->getPosition() != batch_position) {
+      arrow_output->flush();
+      batch_position = reader->getPosition();
+    }
 
     if (good_rec && pid_node->getLength() == 0) continue;
     if (elec_first && pid_node->getValue(0) != 11) continue;
+    hipo::profiler::resume(stage_join);
 
     l = run_node->getLength();
     run.resize(l);
@@ -647,23 +1060,53 @@ int main(int argc, char **argv) {
       solenoid[i] = solenoid_node->getValue(i);
     }
 
-    l = crate_node->getLength();
-    crate.resize(l);
-    slot.resize(l);
-    channel.resize(l);
-    helicity.resize(l);
-    quartet.resize(l);
-    value.resize(l);
+    if (runinfo && l > 0) {
+      if (!ri_open || run[0] != ri_run || torus[0] != ri_torus || solenoid[0] != ri_solenoid) {
+        if (ri_open) runinfo_tree->Fill();
+        ri_run = run[0];
+        ri_torus = torus[0];
+        ri_solenoid = solenoid[0];
+        ri_first_event = event[0];
+        ri_first_entry = written;
+        ri_open = true;
+      }
+      ri_last_event = event[0];
+      ri_last_entry = written;
+    }
 
-    for (int i = 0; i < l; i++) {
-      crate[i] = crate_node->getValue(i);
-      slot[i] = slot_node->getValue(i);
-      channel[i] = channel_node->getValue(i);
-      helicity[i] = helicity_node->getValue(i);
-      quartet[i] = quartet_node->getValue(i);
-      value[i] = value_node->getValue(i);
+    if (native) {
+      copyNode(crate_node, crate_native);
+      copyNode(slot_node, slot_native);
+      copyNode(channel_node, channel_native);
+      copyNode(helicity_node, helicity_native);
+      copyNode(quartet_node, quartet_native);
+      copyNode(value_node, value);
+    } else {
+      l = crate_node->getLength();
+      crate.resize(l);
+      slot.resize(l);
+      channel.resize(l);
+      helicity.resize(l);
+      quartet.resize(l);
+      value.resize(l);
+
+      for (int i = 0; i < l; i++) {
+        crate[i] = crate_node->getValue(i);
+        slot[i] = slot_node->getValue(i);
+        channel[i] = channel_node->getValue(i);
+        helicity[i] = helicity_node->getValue(i);
+        quartet[i] = quartet_node->getValue(i);
+        value[i] = value_node->getValue(i);
+      }
     }
 
+    copyNode(TRG_node, TRG);
+
+    if (runinfo && crate_node->getLength() > 0) {
+      scaler_entry = written;
+      scaler_event = (event.size() > 0) ? event[0] : -1;
+      scaler_tree->Fill();
+    }
     l = STTime_node->getLength();
     STTime.resize(l);
     RFTime.resize(l);
@@ -686,10 +1129,12 @@ int main(int argc, char **argv) {
     vx.resize(l);
     vy.resize(l);
     vz.resize(l);
-    charge.resize(l);
     beta.resize(l);
     chi2pid.resize(l);
-    status.resize(l);
+    if (!native) {
+      charge.resize(l);
+      status.resize(l);
+    }
 
     for (int i = 0; i < l; i++) {
       pid[i] = pid_node->getValue(i);
@@ -702,15 +1147,19 @@ int main(int argc, char **argv) {
       vx[i] = vx_node->getValue(i);
       vy[i] = vy_node->getValue(i);
       vz[i] = vz_node->getValue(i);
-      charge[i] = charge_node->getValue(i);
+      if (!native) charge[i] = charge_node->getValue(i);
       beta[i] = ((beta_node->getValue(i) != -9999) ? beta_node->getValue(i) : NaN);
       chi2pid[i] = chi2pid_node->getValue(i);
-      status[i] = status_node->getValue(i);
+      if (!native) status[i] = status_node->getValue(i);
       mass[i] = massFromPID(pid[i]);
       energy[i] = ROOT::Math::sqrt(p2[i] + mass[i]);
 
       particle[i].SetPxPyPzE(px[i], py[i], pz[i], energy[i]);
     }
+    if (native) {
+      copyNode(charge_node, charge_native);
+      copyNode(status_node, status_native);
+    }
 
     if (is_mc) {
       l = MC_pid_node->getLength();
@@ -1388,8 +1837,10 @@ int main(int argc, char **argv) {
 
 
 	for( int i = 0; i < l; i++ ){
-	  cvt_pid[i] = CVT_pid_node->getValue(i);
-	  cvt_q[i] = CVT_q_node->getValue(i);
+	  if (!native) {
+	    cvt_pid[i] = CVT_pid_node->getValue(i);
+	    cvt_q[i] = CVT_q_node->getValue(i);
+	  }
 	  cvt_p[i] = CVT_p_node->getValue(i);
 	  cvt_phi0[i] = CVT_phi0_node->getValue(i);
 	  cvt_tandip[i] = CVT_tandip_node->getValue(i);
@@ -1404,12 +1855,53 @@ int main(int argc, char **argv) {
 	  cvt_CovMat_z02[i] = CVT_Cov_z02_node->getValue(i);
 	  cvt_CovMat_tandip2[i] = CVT_Cov_tandip2_node->getValue(i);
 	}
+	if (native) {
+	  copyNode(CVT_pid_node, cvt_pid_native);
+	  copyNode(CVT_q_node, cvt_q_native);
+	}
 	
       }
       
     }
     
-    clas12->Fill();
+    if (native) {
+      narrowCopy(ec_pcal_sec, ec_pcal_sec_native);
+      narrowCopy(ec_ecin_sec, ec_ecin_sec_native);
+      narrowCopy(ec_ecout_sec, ec_ecout_sec_native);
+      narrowCopy(dc_sector, dc_sector_native);
+      narrowCopy(cc_ltcc_sec, cc_ltcc_sec_native);
+      narrowCopy(cc_htcc_sec, cc_htcc_sec_native);
+      narrowCopy(sc_ftof_sec, sc_ftof_sec_native);
+    }
+    columns.applyPrecision();
+    hipo::profiler::pause(stage_join, 0, 1);
+
+    if (histograms.size() > 0) {
+      hipo::profiler::resume(stage_hist);
+      histograms.fill();
+      hipo::profiler::pause(stage_hist, 0, 1);
+    }
+
+    if (skims.size() > 0) {
+      hipo::profiler::resume(stage_skim);
+      skims.fill();
+      hipo::profiler::pause(stage_skim, 0, 1);
+    }
+
+    hipo::profiler::resume(stage_fill);
+    if (arrow)
+      arrow_output->fill();
+    else if (flat)
+      particles->fill(pid.size());
+    else if (!hist_only)
+      clas12->Fill();
+    for (int t = 0; t < split_trees.size(); t++) split_trees[t]->Fill();
+    hipo::profiler::pause(stage_fill, 0, 1);
+    reporter.setEventsWritten(++written);
+    if (written % 1000 == 0)
+      reporter.setBytesWritten(arrow ? arrow_output->getBytesWritten() : OutputFile->GetBytesWritten());
+    if (follow >= 0 && written % 1000 == 0 && std::chrono::steady_clock::now() - flush_time > std::chrono::seconds(10))
+      flush_output();
     /*
       std::cout << "del" << '\n';
     run.clear();
@@ -1617,14 +2109,51 @@ int main(int argc, char **argv) {
     */
   }
 
-  OutputFile->cd();
-  clas12->Write();
-  OutputFile->Close();
+  hipo::profiler::resume(stage_write);
+  if (ri_open) runinfo_tree->Fill();
+
+  long bytes_written = 0;
+  if (arrow) {
+    arrow_output->close();
+    bytes_written = arrow_output->getBytesWritten();
+  } else {
+    OutputFile->cd();
+    if (flat)
+      particles->getTree()->Write();
+    else if (!hist_only)
+      clas12->Write();
+    histograms.write(OutputFile);
+    if (SplitMode == "trees") {
+      for (int t = 0; t < split_trees.size(); t++) split_trees[t]->Write();
+    }
+    if (runinfo) {
+      runinfo_tree->Write();
+      scaler_tree->Write();
+    }
+    OutputFile->Close();
+    bytes_written = OutputFile->GetBytesWritten();
+  }
+  for (int f = 0; f < split_files.size(); f++) {
+    split_files[f]->cd();
+    split_trees[f]->Write();
+    split_files[f]->Close();
+    bytes_written += split_files[f]->GetBytesWritten();
+  }
+  skims.stop();
+  hipo::profiler::pause(stage_write, bytes_written);
+
+  reporter.stop();
+  reporter.setBytesWritten(bytes_written);
+  if (!is_batch) std::cout << reporter.getStatistics() << skims.getSummary();
+  if (StatsFileName != "") {
+    std::ofstream stats(StatsFileName.c_str());
+    stats << reporter.getStatistics();
+  }
 
-  if (!is_batch) {
+  if (profile) {
     std::chrono::duration<double> elapsed_full = (std::chrono::high_resolution_clock::now() - start_full);
-    std::cout << "Elapsed time: " << elapsed_full.count() << " s" << std::endl;
-    std::cout << "Events/Sec: " << entry / elapsed_full.count() << " Hz" << std::endl;
+    hipo::profiler::show(elapsed_full.count());
+    std::cout << hipo::profiler::getJson(elapsed_full.count()) << std::endl;
   }
 
   return 0;
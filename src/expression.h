@@ -0,0 +1,288 @@
+/**************************************/
+/*                                    */
+/*  Expressions over output columns   */
+/*                                    */
+/**************************************/
+
+#ifndef EXPRESSION_H_GUARD
+#define EXPRESSION_H_GUARD
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "columns.h"
+
+// Value of one row of a registered column, NaN past the end
+inline double columnValue(const Column *column, int row) {
+  switch (column->type) {
+    case COLUMN_CHAR: {
+      std::vector<Char_t> &vec = *reinterpret_cast<std::vector<Char_t> *>(column->address);
+      return (row < vec.size()) ? vec[row] : NAN;
+    }
+    case COLUMN_SHORT: {
+      std::vector<Short_t> &vec = *reinterpret_cast<std::vector<Short_t> *>(column->address);
+      return (row < vec.size()) ? vec[row] : NAN;
+    }
+    case COLUMN_INT: {
+      std::vector<Int_t> &vec = *reinterpret_cast<std::vector<Int_t> *>(column->address);
+      return (row < vec.size()) ? vec[row] : NAN;
+    }
+    case COLUMN_LONG: {
+      std::vector<Long64_t> &vec = *reinterpret_cast<std::vector<Long64_t> *>(column->address);
+      return (row < vec.size()) ? vec[row] : NAN;
+    }
+    case COLUMN_FLOAT: {
+      std::vector<Float_t> &vec = *reinterpret_cast<std::vector<Float_t> *>(column->address);
+      return (row < vec.size()) ? vec[row] : NAN;
+    }
+  }
+  return NAN;
+}
+
+inline int columnSize(const Column *column) {
+  switch (column->type) {
+    case COLUMN_CHAR: return reinterpret_cast<std::vector<Char_t> *>(column->address)->size();
+    case COLUMN_SHORT: return reinterpret_cast<std::vector<Short_t> *>(column->address)->size();
+    case COLUMN_INT: return reinterpret_cast<std::vector<Int_t> *>(column->address)->size();
+    case COLUMN_LONG: return reinterpret_cast<std::vector<Long64_t> *>(column->address)->size();
+    case COLUMN_FLOAT: return reinterpret_cast<std::vector<Float_t> *>(column->address)->size();
+  }
+  return 0;
+}
+
+// Arithmetic expression over output columns, e.g.
+//   ec_tot_energy / p
+//   pid == 11 && charge < 0 && abs(vz) < 10
+//   p[0]
+//   row >= 1 && beta >= 0.05
+// A column name stands for its value in the row being evaluated, event
+// columns always give their first row and name[k] picks row k. row is
+// the number of the row being evaluated.
+// Functions: sqrt abs exp log sin cos tan atan2 pow min max
+class Expression {
+ private:
+  enum {
+    OP_NUMBER, OP_COLUMN, OP_ROW, OP_NEG, OP_NOT, OP_ADD, OP_SUB, OP_MUL, OP_DIV,
+    OP_LT, OP_LE, OP_GT, OP_GE, OP_EQ, OP_NE, OP_AND, OP_OR,
+    OP_SQRT, OP_ABS, OP_EXP, OP_LOG, OP_SIN, OP_COS, OP_TAN, OP_ATAN2, OP_POW, OP_MIN, OP_MAX
+  };
+  struct Node {
+    int op;
+    double value;
+    Column *column;
+    int row;  // fixed row, -1 = the row being evaluated
+    int left;
+    int right;
+  };
+
+  std::vector<Node> nodes;
+  std::vector<Column *> rowColumns;
+  std::string text;
+  size_t pos;
+  ColumnRegistry *registry;
+
+  void fail(const std::string &what) {
+    std::cerr << "[ERROR] " << what << " at position " << pos << " in expression : " << text << std::endl;
+    exit(1);
+  }
+  void skip() {
+    while (pos < text.size() && isspace(text[pos])) pos++;
+  }
+  bool accept(const char *token) {
+    skip();
+    size_t n = strlen(token);
+    if (text.compare(pos, n, token) != 0) return false;
+    pos += n;
+    return true;
+  }
+  int add(int op, int left = -1, int right = -1) {
+    Node node;
+    node.op = op;
+    node.value = 0;
+    node.column = NULL;
+    node.row = -1;
+    node.left = left;
+    node.right = right;
+    nodes.push_back(node);
+    return nodes.size() - 1;
+  }
+
+  int parseOr() {
+    int left = parseAnd();
+    while (accept("||")) left = add(OP_OR, left, parseAnd());
+    return left;
+  }
+  int parseAnd() {
+    int left = parseCompare();
+    while (accept("&&")) left = add(OP_AND, left, parseCompare());
+    return left;
+  }
+  int parseCompare() {
+    int left = parseSum();
+    while (true) {
+      if (accept("==")) left = add(OP_EQ, left, parseSum());
+      else if (accept("!=")) left = add(OP_NE, left, parseSum());
+      else if (accept("<=")) left = add(OP_LE, left, parseSum());
+      else if (accept(">=")) left = add(OP_GE, left, parseSum());
+      else if (accept("<")) left = add(OP_LT, left, parseSum());
+      else if (accept(">")) left = add(OP_GT, left, parseSum());
+      else return left;
+    }
+  }
+  int parseSum() {
+    int left = parseProduct();
+    while (true) {
+      if (accept("+")) left = add(OP_ADD, left, parseProduct());
+      else if (accept("-")) left = add(OP_SUB, left, parseProduct());
+      else return left;
+    }
+  }
+  int parseProduct() {
+    int left = parseUnary();
+    while (true) {
+      if (accept("*")) left = add(OP_MUL, left, parseUnary());
+      else if (accept("/")) left = add(OP_DIV, left, parseUnary());
+      else return left;
+    }
+  }
+  int parseUnary() {
+    if (accept("-")) return add(OP_NEG, parseUnary());
+    if (accept("!")) return add(OP_NOT, parseUnary());
+    return parsePrimary();
+  }
+  int parsePrimary() {
+    skip();
+    if (accept("(")) {
+      int inner = parseOr();
+      if (!accept(")")) fail("missing )");
+      return inner;
+    }
+    if (pos < text.size() && (isdigit(text[pos]) || text[pos] == '.')) {
+      const char *start = text.c_str() + pos;
+      char *end;
+      double value = strtod(start, &end);
+      pos += end - start;
+      int node = add(OP_NUMBER);
+      nodes[node].value = value;
+      return node;
+    }
+    size_t start = pos;
+    while (pos < text.size() && (isalnum(text[pos]) || text[pos] == '_')) pos++;
+    if (pos == start) fail("unexpected character");
+    std::string name = text.substr(start, pos - start);
+    if (accept("(")) return parseCall(name);
+    if (name == "row") return add(OP_ROW);
+
+    Column *column = registry->find(name.c_str());
+    if (column == NULL || column->type == COLUMN_OTHER) fail("unknown column " + name);
+    int node = add(OP_COLUMN);
+    nodes[node].column = column;
+    if (accept("[")) {
+      skip();
+      nodes[node].row = strtol(text.c_str() + pos, NULL, 10);
+      while (pos < text.size() && isdigit(text[pos])) pos++;
+      if (!accept("]")) fail("missing ]");
+    } else if (column->shape == SHAPE_EVENT) {
+      nodes[node].row = 0;
+    } else {
+      rowColumns.push_back(column);
+    }
+    return node;
+  }
+  int parseCall(const std::string &name) {
+    static const char *names[] = {"sqrt", "abs", "exp", "log", "sin", "cos", "tan", "atan2", "pow", "min", "max"};
+    for (int f = 0; f < 11; f++) {
+      if (name != names[f]) continue;
+      int op = OP_SQRT + f;
+      int left = parseOr();
+      int right = -1;
+      if (op >= OP_ATAN2) {
+        if (!accept(",")) fail(name + " needs two arguments");
+        right = parseOr();
+      }
+      if (!accept(")")) fail("missing )");
+      return add(op, left, right);
+    }
+    fail("unknown function " + name);
+    return -1;
+  }
+
+  double evaluate(int n, int row) {
+    const Node &node = nodes[n];
+    switch (node.op) {
+      case OP_NUMBER: return node.value;
+      case OP_COLUMN: return columnValue(node.column, (node.row < 0) ? row : node.row);
+      case OP_ROW: return row;
+      case OP_NEG: return -evaluate(node.left, row);
+      case OP_NOT: return !evaluate(node.left, row);
+      case OP_ADD: return evaluate(node.left, row) + evaluate(node.right, row);
+      case OP_SUB: return evaluate(node.left, row) - evaluate(node.right, row);
+      case OP_MUL: return evaluate(node.left, row) * evaluate(node.right, row);
+      case OP_DIV: return evaluate(node.left, row) / evaluate(node.right, row);
+      case OP_LT: return evaluate(node.left, row) < evaluate(node.right, row);
+      case OP_LE: return evaluate(node.left, row) <= evaluate(node.right, row);
+      case OP_GT: return evaluate(node.left, row) > evaluate(node.right, row);
+      case OP_GE: return evaluate(node.left, row) >= evaluate(node.right, row);
+      case OP_EQ: return evaluate(node.left, row) == evaluate(node.right, row);
+      case OP_NE: return evaluate(node.left, row) != evaluate(node.right, row);
+      case OP_AND: return evaluate(node.left, row) && evaluate(node.right, row);
+      case OP_OR: return evaluate(node.left, row) || evaluate(node.right, row);
+      case OP_SQRT: return std::sqrt(evaluate(node.left, row));
+      case OP_ABS: return std::fabs(evaluate(node.left, row));
+      case OP_EXP: return std::exp(evaluate(node.left, row));
+      case OP_LOG: return std::log(evaluate(node.left, row));
+      case OP_SIN: return std::sin(evaluate(node.left, row));
+      case OP_COS: return std::cos(evaluate(node.left, row));
+      case OP_TAN: return std::tan(evaluate(node.left, row));
+      case OP_ATAN2: return std::atan2(evaluate(node.left, row), evaluate(node.right, row));
+      case OP_POW: return std::pow(evaluate(node.left, row), evaluate(node.right, row));
+      case OP_MIN: return std::fmin(evaluate(node.left, row), evaluate(node.right, row));
+      case OP_MAX: return std::fmax(evaluate(node.left, row), evaluate(node.right, row));
+    }
+    return NAN;
+  }
+
+ public:
+  Expression() {}
+  Expression(const std::string &expression, ColumnRegistry &columns) {
+    text = expression;
+    pos = 0;
+    registry = &columns;
+    parseOr();
+    skip();
+    if (pos != text.size()) fail("unexpected text");
+  }
+
+  bool empty() { return nodes.size() == 0; }
+  // columns that are evaluated row by row
+  std::vector<Column *> &getRowColumns() { return rowColumns; }
+  // the root is the last node added
+  double evaluate(int row) { return evaluate(nodes.size() - 1, row); }
+
+  // Number of rows of the current event, the shortest of the row
+  // columns, 1 when only event columns are used
+  int getRows() {
+    int rows = 1;
+    for (int c = 0; c < rowColumns.size(); c++) {
+      int l = columnSize(rowColumns[c]);
+      if (c == 0 || l < rows) rows = l;
+    }
+    return rows;
+  }
+
+  // True when the expression holds for at least one row
+  bool any() {
+    int rows = getRows();
+    for (int row = 0; row < rows; row++) {
+      if (evaluate(row) != 0) return true;
+    }
+    return false;
+  }
+};
+
+#endif
@@ -15,7 +15,7 @@ bank::~bank() {}
 bank::bank(const char *bankName, hipo::reader &r) {
   hipo::dictionary *dict = r.getSchemaDictionary();
   if (dict->hasSchema(bankName) == true) {
-    hipo::schema schema = dict->getSchema(bankName);
+    const hipo::schema &schema = dict->getSchema(bankName);
     int group = schema.getGroup();
     std::vector<std::string> entries = schema.getEntryList();
     // printf("bank : %s %d\n",schema.getName().c_str(),group);
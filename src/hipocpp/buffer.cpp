@@ -0,0 +1,129 @@
+/*
+ * Pooled record and event buffers, see buffer.h
+ */
+
+#include "buffer.h"
+
+#include <sys/mman.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace hipo {
+
+static const size_t BUFFER_ALIGNMENT = 64;
+static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+bufferPool::bufferPool() {
+  pooledBytes = 0;
+  allocatedBytes = 0;
+  watermark = 64L * 1024 * 1024;
+  hugePages = false;
+}
+
+/** never destroyed, buffers of static objects are released after main() returns */
+bufferPool &bufferPool::instance() {
+  static bufferPool *pool = new bufferPool();
+  return *pool;
+}
+
+int bufferPool::sizeClass(size_t bytes) {
+  int c = MIN_CLASS;
+  while (c < MAX_CLASS && (((size_t)1) << c) < bytes) c++;
+  return c;
+}
+
+void *bufferPool::allocate(size_t bytes) {
+  bufferPool &pool = instance();
+  int c = sizeClass(bytes);
+  size_t size = ((size_t)1) << c;
+  bool huge = false;
+  {
+    std::lock_guard<std::mutex> guard(pool.lock);
+    if (pool.freeBlocks[c].empty() == false) {
+      void *ptr = pool.freeBlocks[c].back();
+      pool.freeBlocks[c].pop_back();
+      pool.pooledBytes -= size;
+      return ptr;
+    }
+    pool.allocatedBytes += size;
+    huge = pool.hugePages && size >= HUGE_PAGE_SIZE;
+  }
+  void *ptr = NULL;
+  if (posix_memalign(&ptr, huge ? HUGE_PAGE_SIZE : BUFFER_ALIGNMENT, size) != 0) {
+    printf("[BUFFER] ** error ** can not allocate %lu bytes\n", size);
+    throw std::bad_alloc();
+  }
+#ifdef MADV_HUGEPAGE
+  if (huge) madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+  return ptr;
+}
+
+void bufferPool::release(void *ptr, size_t bytes) {
+  if (ptr == NULL) return;
+  bufferPool &pool = instance();
+  int c = sizeClass(bytes);
+  long size = ((long)1) << c;
+  {
+    std::lock_guard<std::mutex> guard(pool.lock);
+    if (pool.pooledBytes + size <= pool.watermark) {
+      pool.freeBlocks[c].push_back(ptr);
+      pool.pooledBytes += size;
+      return;
+    }
+    pool.allocatedBytes -= size;
+  }
+  free(ptr);
+}
+
+void bufferPool::setWatermark(long bytes) {
+  bufferPool &pool = instance();
+  {
+    std::lock_guard<std::mutex> guard(pool.lock);
+    pool.watermark = bytes;
+  }
+  trim();
+}
+
+void bufferPool::setHugePages(bool flag) {
+  bufferPool &pool = instance();
+  std::lock_guard<std::mutex> guard(pool.lock);
+  pool.hugePages = flag;
+}
+
+void bufferPool::trim() {
+  bufferPool &pool = instance();
+  std::lock_guard<std::mutex> guard(pool.lock);
+  for (int c = MIN_CLASS; c <= MAX_CLASS; c++) {
+    for (int i = 0; i < pool.freeBlocks[c].size(); i++) free(pool.freeBlocks[c][i]);
+    pool.allocatedBytes -= (((long)1) << c) * pool.freeBlocks[c].size();
+    pool.freeBlocks[c].clear();
+  }
+  pool.pooledBytes = 0;
+}
+
+long bufferPool::getPooledBytes() {
+  bufferPool &pool = instance();
+  std::lock_guard<std::mutex> guard(pool.lock);
+  return pool.pooledBytes;
+}
+
+long bufferPool::getAllocatedBytes() {
+  bufferPool &pool = instance();
+  std::lock_guard<std::mutex> guard(pool.lock);
+  return pool.allocatedBytes;
+}
+
+void fitBuffer(byteBuffer &buffer, size_t size, size_t slack) {
+  if (buffer.size() < size) {
+    buffer.resize(size + slack);
+    return;
+  }
+  if (buffer.capacity() > 4 * (size + slack) && buffer.capacity() > 1024 * 1024) {
+    byteBuffer smaller(size + slack);
+    buffer.swap(smaller);
+  }
+}
+
+}  // namespace hipo
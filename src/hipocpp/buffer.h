@@ -0,0 +1,105 @@
+/*
+ * File:   buffer.h
+ *
+ * Memory for record and event buffers. The blocks come from a process
+ * wide pool sorted in power of two size classes, so a buffer released
+ * by one record (or reader) is handed to the next one that grows
+ * instead of going back to malloc. Blocks are 64 byte aligned, large
+ * blocks can be backed by transparent huge pages, and the pool keeps
+ * at most a watermark of free memory so a spike of large records does
+ * not stay allocated for the rest of the job.
+ *
+ * byteBuffer is a std::vector<char> using the pool, resize() does not
+ * zero the new bytes (they are always overwritten by a read or a
+ * decompression).
+ */
+
+#ifndef HIPO_BUFFER_H
+#define HIPO_BUFFER_H
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace hipo {
+
+class bufferPool {
+ private:
+  static const int MIN_CLASS = 8;  // 256 bytes
+  static const int MAX_CLASS = 40;
+
+  std::mutex lock;
+  std::vector<void *> freeBlocks[MAX_CLASS + 1];
+  long pooledBytes;     // free blocks kept for reuse
+  long allocatedBytes;  // blocks obtained from the system
+  long watermark;
+  bool hugePages;
+
+  bufferPool();
+  static bufferPool &instance();
+  static int sizeClass(size_t bytes);
+
+ public:
+  static void *allocate(size_t bytes);
+  static void release(void *ptr, size_t bytes);
+
+  /** free memory the pool keeps for reuse, larger blocks go back to the system */
+  static void setWatermark(long bytes);
+  /** back blocks of 2 MB and more with transparent huge pages (off by default) */
+  static void setHugePages(bool flag);
+  /** returns all free blocks to the system */
+  static void trim();
+
+  static long getPooledBytes();
+  static long getAllocatedBytes();
+};
+
+/**
+ * allocator for std::vector taking its memory from the pool, elements
+ * are default initialized so resize() leaves new bytes untouched.
+ */
+template <class T>
+class poolAllocator {
+ public:
+  typedef T value_type;
+
+  poolAllocator() {}
+  template <class U>
+  poolAllocator(const poolAllocator<U> &) {}
+
+  T *allocate(size_t n) { return static_cast<T *>(bufferPool::allocate(n * sizeof(T))); }
+  void deallocate(T *ptr, size_t n) { bufferPool::release(ptr, n * sizeof(T)); }
+
+  template <class U>
+  void construct(U *ptr) {
+    ::new (static_cast<void *>(ptr)) U;
+  }
+  template <class U, class... Args>
+  void construct(U *ptr, Args &&...args) {
+    ::new (static_cast<void *>(ptr)) U(std::forward<Args>(args)...);
+  }
+};
+
+template <class T, class U>
+bool operator==(const poolAllocator<T> &, const poolAllocator<U> &) {
+  return true;
+}
+template <class T, class U>
+bool operator!=(const poolAllocator<T> &, const poolAllocator<U> &) {
+  return false;
+}
+
+typedef std::vector<char, poolAllocator<char> > byteBuffer;
+
+/**
+ * makes buffer at least size bytes long, growing to size + slack. A
+ * buffer more than four times larger than needed (after an outlier
+ * record) is replaced by a smaller one and its block goes back to the pool.
+ */
+void fitBuffer(byteBuffer &buffer, size_t size, size_t slack);
+
+}  // namespace hipo
+
+#endif /* HIPO_BUFFER_H */
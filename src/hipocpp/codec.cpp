@@ -0,0 +1,200 @@
+/*
+ * Record decompression, see codec.h
+ */
+
+#include "codec.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#ifdef __LZ4__
+#include "lz4.h"
+#endif
+#ifdef __ZLIB__
+#include <zlib.h>
+#endif
+#ifdef __ZSTD__
+#include <zstd.h>
+#endif
+
+namespace hipo {
+
+class noneCodec : public codec {
+ public:
+  const char *getName() { return "none"; }
+  int decompress(const char *src, int srcLength, char *dest, int destLength) {
+    int length = (srcLength < destLength) ? srcLength : destLength;
+    memcpy(dest, src, length);
+    return length;
+  }
+  int decompressPartial(const char *src, int srcLength, char *dest, int targetLength, int destLength) {
+    return decompress(src, srcLength, dest, targetLength);
+  }
+};
+
+#ifdef __LZ4__
+class lz4Codec : public codec {
+ private:
+  const char *name;
+
+ public:
+  lz4Codec(const char *n) : name(n) {}
+  const char *getName() { return name; }
+  int decompress(const char *src, int srcLength, char *dest, int destLength) {
+    int result = LZ4_decompress_safe(src, dest, srcLength, destLength);
+    return (result < 0) ? -1 : result;
+  }
+  int decompressPartial(const char *src, int srcLength, char *dest, int targetLength, int destLength) {
+    int result = LZ4_decompress_safe_partial(src, dest, srcLength, targetLength, destLength);
+    return (result < 0) ? -1 : result;
+  }
+};
+#endif
+
+#ifdef __ZLIB__
+class gzipCodec : public codec {
+ private:
+  /** inflate state of the calling thread, reset for every record */
+  struct context {
+    z_stream stream;
+    bool ready;
+    context() : ready(false) {
+      memset(&stream, 0, sizeof(stream));
+      // 32 : accept both gzip and zlib headers
+      ready = (inflateInit2(&stream, 32 + MAX_WBITS) == Z_OK);
+    }
+    ~context() {
+      if (ready) inflateEnd(&stream);
+    }
+  };
+  /** resets the stream of the calling thread for a new record */
+  static z_stream *start(const char *src, int srcLength, char *dest, int destLength) {
+    static thread_local context local;
+    if (local.ready == false || inflateReset(&local.stream) != Z_OK) return NULL;
+    local.stream.next_in = (Bytef *)src;
+    local.stream.avail_in = srcLength;
+    local.stream.next_out = (Bytef *)dest;
+    local.stream.avail_out = destLength;
+    return &local.stream;
+  }
+
+ public:
+  const char *getName() { return "gzip"; }
+  int decompress(const char *src, int srcLength, char *dest, int destLength) {
+    z_stream *stream = start(src, srcLength, dest, destLength);
+    if (stream == NULL) return -1;
+    int status = inflate(stream, Z_FINISH);
+    if (status != Z_STREAM_END && status != Z_BUF_ERROR) return -1;
+    if (status == Z_BUF_ERROR && stream->avail_out != 0) return -1;
+    return destLength - stream->avail_out;
+  }
+  int decompressPartial(const char *src, int srcLength, char *dest, int targetLength, int destLength) {
+    z_stream *stream = start(src, srcLength, dest, targetLength);
+    if (stream == NULL) return -1;
+    while (stream->avail_out > 0) {
+      int status = inflate(stream, Z_NO_FLUSH);
+      if (status == Z_STREAM_END) break;
+      if (status != Z_OK) return -1;
+    }
+    return targetLength - stream->avail_out;
+  }
+};
+#endif
+
+#ifdef __ZSTD__
+class zstdCodec : public codec {
+ private:
+  /** decompression context of the calling thread */
+  struct context {
+    ZSTD_DCtx *dctx;
+    context() { dctx = ZSTD_createDCtx(); }
+    ~context() { ZSTD_freeDCtx(dctx); }
+  };
+  static ZSTD_DCtx *local() {
+    static thread_local context c;
+    return c.dctx;
+  }
+
+ public:
+  const char *getName() { return "zstd"; }
+  int decompress(const char *src, int srcLength, char *dest, int destLength) {
+    ZSTD_DCtx *dctx = local();
+    if (dctx == NULL) return -1;
+    size_t result = ZSTD_decompressDCtx(dctx, dest, destLength, src, srcLength);
+    return ZSTD_isError(result) ? -1 : (int)result;
+  }
+  int decompressPartial(const char *src, int srcLength, char *dest, int targetLength, int destLength) {
+    ZSTD_DCtx *dctx = local();
+    if (dctx == NULL) return -1;
+    ZSTD_DCtx_reset(dctx, ZSTD_reset_session_only);
+    ZSTD_inBuffer input = {src, (size_t)srcLength, 0};
+    ZSTD_outBuffer output = {dest, (size_t)targetLength, 0};
+    while (output.pos < output.size) {
+      size_t consumed = input.pos, produced = output.pos;
+      size_t result = ZSTD_decompressStream(dctx, &output, &input);
+      if (ZSTD_isError(result)) return -1;
+      if (result == 0 || (input.pos == consumed && output.pos == produced)) break;
+    }
+    return (int)output.pos;
+  }
+};
+#endif
+
+namespace {
+/**
+ * the decoders indexed by compression type, built on first use. Lookups
+ * are lock free, registration takes the lock and moves a replaced
+ * decoder to the retired list instead of deleting it.
+ */
+struct codecTable {
+  std::atomic<codec *> codecs[codecRegistry::MAX_TYPE + 1];
+  std::mutex lock;
+  std::vector<codec *> retired;
+  codecTable() {
+    for (int i = 0; i <= codecRegistry::MAX_TYPE; i++) codecs[i].store(NULL, std::memory_order_relaxed);
+    codecs[codecRegistry::NONE].store(new noneCodec(), std::memory_order_relaxed);
+#ifdef __LZ4__
+    codecs[codecRegistry::LZ4].store(new lz4Codec("lz4"), std::memory_order_relaxed);
+    codecs[codecRegistry::LZ4_HC].store(new lz4Codec("lz4hc"), std::memory_order_relaxed);
+#endif
+#ifdef __ZLIB__
+    codecs[codecRegistry::GZIP].store(new gzipCodec(), std::memory_order_relaxed);
+#endif
+#ifdef __ZSTD__
+    codecs[codecRegistry::ZSTD].store(new zstdCodec(), std::memory_order_relaxed);
+#endif
+  }
+};
+
+codecTable &table() {
+  // never destroyed, records can still be decoded during static destruction
+  static codecTable *instance = new codecTable();
+  return *instance;
+}
+}  // namespace
+
+codec *codecRegistry::get(int type) {
+  if (type < 0 || type > MAX_TYPE) return NULL;
+  return table().codecs[type].load(std::memory_order_acquire);
+}
+
+void codecRegistry::add(int type, codec *decoder) {
+  if (type < 0 || type > MAX_TYPE) {
+    printf("[CODEC] ** error ** compression type %d is out of range\n", type);
+    return;
+  }
+  codecTable &t = table();
+  std::lock_guard<std::mutex> guard(t.lock);
+  codec *previous = t.codecs[type].exchange(decoder, std::memory_order_acq_rel);
+  if (previous != NULL && previous != decoder) t.retired.push_back(previous);
+}
+
+void codecRegistry::show() {
+  for (int i = 0; i <= MAX_TYPE; i++)
+    if (get(i) != NULL) printf("[CODEC] compression type %2d : %s\n", i, get(i)->getName());
+}
+
+}  // namespace hipo
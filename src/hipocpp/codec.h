@@ -0,0 +1,65 @@
+/*
+ * File:   codec.h
+ *
+ * Decompression of record data. The compression type is the top four
+ * bits of the compressed length word in the record header, each type
+ * has a decoder registered here:
+ *
+ *   0  none
+ *   1  LZ4 (fast)
+ *   2  LZ4 (written with the high compression mode, same decoder)
+ *   3  gzip (zlib)
+ *   4  ZSTD
+ *
+ * gzip and ZSTD are only available when the library was built with
+ * zlib (__ZLIB__) and libzstd (__ZSTD__). The zlib stream and the ZSTD
+ * context are created once per thread and reused for every record,
+ * so decoding does not allocate. Other types can be added with
+ * codecRegistry::add().
+ */
+
+#ifndef HIPO_CODEC_H
+#define HIPO_CODEC_H
+
+namespace hipo {
+
+class codec {
+ public:
+  virtual ~codec() {}
+  virtual const char *getName() = 0;
+  /**
+   * decompresses srcLength bytes from src into dest (destLength bytes
+   * available), returns the number of bytes written or -1 on error.
+   */
+  virtual int decompress(const char *src, int srcLength, char *dest, int destLength) = 0;
+  /**
+   * decompresses at least the first targetLength bytes (more when the
+   * codec works in blocks), returns the number of bytes written or -1.
+   * Used when only the first events of a record are needed.
+   */
+  virtual int decompressPartial(const char *src, int srcLength, char *dest, int targetLength, int destLength) {
+    return decompress(src, srcLength, dest, destLength);
+  }
+};
+
+class codecRegistry {
+ public:
+  enum compression_t { NONE = 0, LZ4 = 1, LZ4_HC = 2, GZIP = 3, ZSTD = 4, MAX_TYPE = 15 };
+
+  /** decoder for the compression type, NULL if not available */
+  static codec *get(int type);
+  /**
+   * registers (or replaces) the decoder of a compression type, the
+   * registry owns it. Safe while other threads call get(), a replaced
+   * decoder is kept alive (not deleted) since a reader may still be
+   * decoding with it.
+   */
+  static void add(int type, codec *decoder);
+  static bool has(int type) { return get(type) != 0; }
+  /** prints the available decoders */
+  static void show();
+};
+
+}  // namespace hipo
+
+#endif /* HIPO_CODEC_H */
@@ -5,28 +5,62 @@
  */
 
 #include <stdlib.h>
+#include <algorithm>
 #include "dictionary.h"
 #include "utils.h"
 
 namespace hipo {
 
-int schema::getType(const char* entry) {
-  if (schemaEntries.count(entry) == 0) {
+namespace {
+/**
+ * true when an item name can not be used as an accessor of the
+ * generated structure: a C++ keyword (alternative tokens included)
+ * or one of the structure's own members.
+ */
+bool isReservedAccessor(const std::string& name) {
+  static const char* reserved[] = {
+      "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor", "bool", "break", "case", "catch",
+      "char", "char16_t", "char32_t", "char8_t", "class", "co_await", "co_return", "co_yield", "compl", "concept",
+      "const", "const_cast", "consteval", "constexpr", "constinit", "continue", "decltype", "default", "delete",
+      "do", "double", "dynamic_cast", "else", "entries", "enum", "explicit", "export", "extern", "false", "float",
+      "for", "friend", "getRows", "goto", "group", "if", "inline", "int", "items", "long", "mutable", "name",
+      "namespace", "new", "noexcept", "nodes", "not", "not_eq", "nullptr", "operator", "or", "or_eq", "private",
+      "protected", "public", "read", "register", "reinterpret_cast", "requires", "return", "rows", "short", "signed",
+      "sizeof", "slot", "static", "static_assert", "static_cast", "struct", "switch", "template", "this",
+      "thread_local", "throw", "true", "try", "typedef", "typeid", "typename", "union", "unsigned", "using",
+      "virtual", "void", "volatile", "wchar_t", "while", "xor", "xor_eq"};
+  static const int count = sizeof(reserved) / sizeof(reserved[0]);
+  for (int i = 0; i < count; i++) {
+    if (name == reserved[i]) return true;
+  }
+  return false;
+}
+}  // namespace
+
+int schema::getType(const char* entry) const {
+  int order = getEntryOrder(entry);
+  if (order < 0) {
     printf("schema:: error, schema %s does no contain entry %s\n", schemaName.c_str(), entry);
+    return 0;
   }
-  return schemaEntries[entry].second;
+  return entryTypes[order];
 }
 
-int schema::getMaxStringLength() {
+int schema::getEntryOrder(const char* entry) const {
+  std::unordered_map<std::string_view, int>::const_iterator it = entryIndex.find(std::string_view(entry));
+  return (it == entryIndex.end()) ? -1 : it->second;
+}
+
+int schema::getMaxStringLength() const {
   int length = 0;
-  for (std::map<std::string, std::pair<int, int> >::iterator it = schemaEntries.begin(); it != schemaEntries.end();
-       ++it) {
+  for (std::map<std::string, std::pair<int, int> >::const_iterator it = schemaEntries.begin();
+       it != schemaEntries.end(); ++it) {
     if (it->first.size() > length) length = it->first.size();
   }
   return length;
 }
 
-std::vector<std::string> schema::getEntryList() {
+std::vector<std::string> schema::getEntryList() const {
   std::vector<std::string> entries;
   /*
   for (std::map<std::string, std::pair<int,int> >::iterator it=schemaEntries.begin();
@@ -39,14 +73,16 @@ std::vector<std::string> schema::getEntryList() {
   return entries;
 }
 
-int schema::getItem(const char* entry) {
-  if (schemaEntries.count(entry) == 0) {
+int schema::getItem(const char* entry) const {
+  int order = getEntryOrder(entry);
+  if (order < 0) {
     printf("schema:: error, schema %s does no contain entry %s\n", schemaName.c_str(), entry);
+    return 0;
   }
-  return schemaEntries[entry].first;
+  return entryItems[order];
 }
 
-int schema::getTypeByString(const char* typestring) {
+int schema::getTypeByString(const char* typestring) const {
   std::string type = typestring;
   if (type.compare("BYTE") == 0) {
     return 1;
@@ -64,7 +100,7 @@ int schema::getTypeByString(const char* typestring) {
   return 0;
 }
 
-std::string schema::getTypeStringSimple(int type) {
+std::string schema::getTypeStringSimple(int type) const {
   std::string typeString = "unknown";
   switch (type) {
     case 1:
@@ -91,7 +127,7 @@ std::string schema::getTypeStringSimple(int type) {
   return typeString;
 }
 
-std::string schema::getTypeString(int type) {
+std::string schema::getTypeString(int type) const {
   std::string typeString = "<unknown>";
   switch (type) {
     case 1:
@@ -117,7 +153,7 @@ std::string schema::getTypeString(int type) {
   }
   return typeString;
 }
-std::string schema::getBranchVariable(const char* var, int max) {
+std::string schema::getBranchVariable(const char* var, int max) const {
   std::string c_var = var;
   while (c_var.size() < max) {
     c_var.insert(0, " ");
@@ -129,7 +165,7 @@ std::string schema::getBranchVariable(const char* var, int max) {
   }
   return c_var;
 }
-std::string schema::getRootTypeString(int type) {
+std::string schema::getRootTypeString(int type) const {
   std::string typeString = "unknown";
   switch (type) {
     case 1:
@@ -155,7 +191,7 @@ std::string schema::getRootTypeString(int type) {
   }
   return typeString;
 }
-std::vector<std::string> schema::getRootBranchesCode() {
+std::vector<std::string> schema::getRootBranchesCode() const {
   std::vector<std::string> code;
   char c_type[128];
   char c_name[128];
@@ -164,8 +200,8 @@ std::vector<std::string> schema::getRootBranchesCode() {
   int maxLength = getMaxStringLength();
   std::string format;
 
-  for (std::map<std::string, std::pair<int, int> >::iterator it = schemaEntries.begin(); it != schemaEntries.end();
-       ++it) {
+  for (std::map<std::string, std::pair<int, int> >::const_iterator it = schemaEntries.begin();
+       it != schemaEntries.end(); ++it) {
     std::string type = getTypeString(it->second.second);
 
     sprintf(c_type, "%-12s", type.c_str());
@@ -188,8 +224,8 @@ std::vector<std::string> schema::getRootBranchesCode() {
 
   sprintf(c_name, "   if(dictionary->hasSchema(\"%s\")==true){", scname.c_str());
   code.push_back(c_name);
-  for (std::map<std::string, std::pair<int, int> >::iterator it = schemaEntries.begin(); it != schemaEntries.end();
-       ++it) {
+  for (std::map<std::string, std::pair<int, int> >::const_iterator it = schemaEntries.begin();
+       it != schemaEntries.end(); ++it) {
     std::string type = getTypeString(it->second.second);
     sprintf(c_type, "%-12s", type.c_str());
 
@@ -209,7 +245,7 @@ std::vector<std::string> schema::getRootBranchesCode() {
   code.push_back(std::string("   }"));
   return code;
 }
-std::vector<std::string> schema::getRootFillCode() {
+std::vector<std::string> schema::getRootFillCode() const {
   std::vector<std::string> code;
   char c_type[128];
   char c_name[128];
@@ -219,8 +255,8 @@ std::vector<std::string> schema::getRootFillCode() {
   std::string format;
   sprintf(c_name, "   if(dictionary->hasSchema(\"%s\")==true){", scname.c_str());
   code.push_back(c_name);
-  for (std::map<std::string, std::pair<int, int> >::iterator it = schemaEntries.begin(); it != schemaEntries.end();
-       ++it) {
+  for (std::map<std::string, std::pair<int, int> >::const_iterator it = schemaEntries.begin();
+       it != schemaEntries.end(); ++it) {
     std::string type = getTypeStringSimple(it->second.second);
     sprintf(c_type, "%-12s", type.c_str());
 
@@ -246,7 +282,7 @@ std::vector<std::string> schema::getRootFillCode() {
   return code;
 }
 
-std::vector<std::string> schema::branchesAccessCode() {
+std::vector<std::string> schema::branchesAccessCode() const {
   std::vector<std::string> code;
   std::string scname = getName();
   int maxLength = getMaxStringLength();
@@ -254,8 +290,8 @@ std::vector<std::string> schema::branchesAccessCode() {
   char c_name[128];
   std::string format;
 
-  for (std::map<std::string, std::pair<int, int> >::iterator it = schemaEntries.begin(); it != schemaEntries.end();
-       ++it) {
+  for (std::map<std::string, std::pair<int, int> >::const_iterator it = schemaEntries.begin();
+       it != schemaEntries.end(); ++it) {
     std::string type = getTypeString(it->second.second);
     sprintf(c_type, "%-12s", type.c_str());
     // node.append(c_type);
@@ -283,7 +319,7 @@ std::vector<std::string> schema::branchesAccessCode() {
   return code;
 }
 
-std::vector<std::string> schema::branchesCode() {
+std::vector<std::string> schema::branchesCode() const {
   std::vector<std::string> code;
   std::string scname = getName();
   int maxLength = getMaxStringLength();
@@ -291,8 +327,8 @@ std::vector<std::string> schema::branchesCode() {
   char c_name[128];
   std::string format;
 
-  for (std::map<std::string, std::pair<int, int> >::iterator it = schemaEntries.begin(); it != schemaEntries.end();
-       ++it) {
+  for (std::map<std::string, std::pair<int, int> >::const_iterator it = schemaEntries.begin();
+       it != schemaEntries.end(); ++it) {
     std::string type = getTypeString(it->second.second);
     std::string node("   hipo::node");
     sprintf(c_type, "%-12s", type.c_str());
@@ -317,9 +353,67 @@ std::vector<std::string> schema::branchesCode() {
   return code;
 }
 
-void schema::ls() {
-  for (std::map<std::string, std::pair<int, int> >::iterator it = schemaEntries.begin(); it != schemaEntries.end();
-       ++it) {
+/**
+ * code of a structure with the bank descriptor as constexpr members and
+ * one accessor per item returning the value of a row with the type of
+ * the dictionary, e.g. REC_Particle::px(row). The nodes are found once
+ * per event by read(event), the accessors do no type or name lookup.
+ */
+std::vector<std::string> schema::bankStructCode() const {
+  std::vector<std::string> code;
+  char c_line[512];
+  std::string structName = schemaName;
+  std::string::size_type pos = structName.find("::");
+  while (pos != std::string::npos) {
+    structName.replace(pos, 2, "_");
+    pos = structName.find("::");
+  }
+  int entries = entryNames.size();
+
+  sprintf(c_line, "struct %s {", structName.c_str());
+  code.push_back(c_line);
+  sprintf(c_line, "  static constexpr const char *name = \"%s\";", schemaName.c_str());
+  code.push_back(c_line);
+  sprintf(c_line, "  static constexpr int group = %d;", groupid);
+  code.push_back(c_line);
+  sprintf(c_line, "  static constexpr int entries = %d;", entries);
+  code.push_back(c_line);
+  code.push_back(std::string("  static constexpr item_t items[entries] = {"));
+  for (int i = 0; i < entries; i++) {
+    sprintf(c_line, "      {\"%s\", %d, %d}%s", entryNames[i].c_str(), entryItems[i], entryTypes[i],
+            (i + 1 < entries) ? "," : "};");
+    code.push_back(c_line);
+  }
+  code.push_back(std::string("  static constexpr int slot(int item) {"));
+  code.push_back(std::string("    switch (item) {"));
+  for (int i = 0; i < entries; i++) {
+    sprintf(c_line, "      case %d: return %d;", entryItems[i], i);
+    code.push_back(c_line);
+  }
+  code.push_back(std::string("    }"));
+  code.push_back(std::string("    return -1;"));
+  code.push_back(std::string("  }"));
+  code.push_back(std::string(""));
+  code.push_back(std::string("  const char *nodes[entries];"));
+  code.push_back(std::string("  int rows = 0;"));
+  code.push_back(std::string(""));
+  code.push_back(std::string("  void read(hipo::event &event) { rows = readBank<" + structName + ">(event, nodes); }"));
+  code.push_back(std::string("  int getRows() const { return rows; }"));
+  for (int i = 0; i < entries; i++) {
+    std::string type = getTypeStringSimple(entryTypes[i]);
+    std::string accessor = entryNames[i];
+    if (isReservedAccessor(accessor) == true) accessor.append("_");
+    sprintf(c_line, "  %s %s(int row) const { return value<%s>(nodes[%d], row); }", type.c_str(), accessor.c_str(),
+            type.c_str(), i);
+    code.push_back(c_line);
+  }
+  code.push_back(std::string("};"));
+  return code;
+}
+
+void schema::ls() const {
+  for (std::map<std::string, std::pair<int, int> >::const_iterator it = schemaEntries.begin();
+       it != schemaEntries.end(); ++it) {
     printf("\tentry %-25s : item = %8d , type = %4d \n", it->first.c_str(), it->second.first, it->second.second);
   }
 }
@@ -328,30 +422,83 @@ void schema::ls() {
  * Dictionary class
  */
 void dictionary::ls(int mode) {
-  for (std::map<std::string, hipo::schema>::iterator it = mapDict.begin(); it != mapDict.end(); ++it) {
-    printf("Schema %-25s : %9d \n", it->first.c_str(), it->second.getGroup());
+  std::vector<std::string> list = getSchemaList();
+  for (int i = 0; i < list.size(); i++) {
+    const hipo::schema& schema = getSchema(list[i].c_str());
+    printf("Schema %-25s : %9d \n", list[i].c_str(), schema.getGroup());
     if (mode > 0) {
-      it->second.ls();
+      schema.ls();
     }
   }
 }
 
-bool dictionary::hasEntry(const char* name, const char* entry) {
-  if (mapDict.count(name) == 0) return false;
-  return mapDict[name].hasEntry(entry);
+const hipo::schema& dictionary::emptySchema() {
+  static const hipo::schema empty;
+  return empty;
+}
+
+dictionary& dictionary::operator=(const dictionary& d) {
+  if (this == &d) return *this;
+  schemas = d.schemas;
+  names = d.names;
+  groupIndex = d.groupIndex;
+  buildNameIndex();
+  return *this;
+}
+/**
+ * the keys of the name index are views of this dictionary's names,
+ * they are rebuilt after a copy.
+ */
+void dictionary::buildNameIndex() {
+  nameIndex.clear();
+  for (int i = 0; i < names.size(); i++) nameIndex[std::string_view(names[i])] = i;
+}
+
+const hipo::schema& dictionary::getSchema(const char* name) const {
+  std::unordered_map<std::string_view, int>::const_iterator it = nameIndex.find(std::string_view(name));
+  if (it == nameIndex.end()) return emptySchema();
+  return schemas[it->second];
+}
+
+bool dictionary::hasEntry(const char* name, const char* entry) const {
+  std::unordered_map<std::string_view, int>::const_iterator it = nameIndex.find(std::string_view(name));
+  if (it == nameIndex.end()) return false;
+  return schemas[it->second].hasEntry(entry);
 }
-std::vector<std::string> dictionary::getSchemaList() {
+/**
+ * returns the schema names in alphabetical order.
+ */
+std::vector<std::string> dictionary::getSchemaList() const {
   std::vector<std::string> list;
-  for (std::map<std::string, hipo::schema>::iterator it = mapDict.begin(); it != mapDict.end(); ++it) {
-    list.push_back(it->first);
+  for (int i = 0; i < schemas.size(); i++) {
+    list.push_back(schemas[i].getName());
   }
+  std::sort(list.begin(), list.end());
   return list;
 }
 
+std::string dictionary::getBanksCode() {
+  std::string code = hipo::utils::getBanksFileHeader();
+  std::vector<std::string> list = getSchemaList();
+  for (int i = 0; i < list.size(); i++) {
+    // a bank without items of a known type (only STRING for example) has nothing to read
+    if (getSchema(list[i].c_str()).getEntries() == 0) continue;
+    std::vector<std::string> lines = getSchema(list[i].c_str()).bankStructCode();
+    for (int k = 0; k < lines.size(); k++) {
+      code.append(lines[k]);
+      code.append("\n");
+    }
+    code.append("\n");
+  }
+  code.append(hipo::utils::getBanksFileTrailer());
+  return code;
+}
+
 void dictionary::parse(std::string dictString) {
   std::vector<std::string> tokens;
   std::string schemahead = hipo::utils::substring(dictString, "{", "}", 0);
   hipo::utils::tokenize(schemahead, tokens, ",");
+  if (tokens.size() < 2) return;
   hipo::schema schema(tokens[1].c_str());
   // int group = std::stoi(tokens[0]);
   int group = std::atoi(tokens[0].c_str());
@@ -376,7 +523,23 @@ void dictionary::parse(std::string dictString) {
       }
     }
   }
-  mapDict[schema.getName()] = schema;
+  int position = schemas.size();
+  std::unordered_map<std::string_view, int>::iterator it = nameIndex.find(std::string_view(schema.getName()));
+  if (it != nameIndex.end()) {
+    // a schema defined again replaces the previous one
+    position = it->second;
+    int previous = schemas[position].getGroup();
+    if (previous >= 0 && previous < groupIndex.size()) groupIndex[previous] = -1;
+    schemas[position] = schema;
+  } else {
+    schemas.push_back(schema);
+    names.push_back(schema.getName());
+    nameIndex[std::string_view(names.back())] = position;
+  }
+  if (group >= 0) {
+    if (group >= groupIndex.size()) groupIndex.resize(group + 1, -1);
+    groupIndex[group] = position;
+  }
 }
 
 }  // namespace hipo
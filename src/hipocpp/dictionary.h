@@ -14,11 +14,15 @@
 #ifndef DICTIONARY_H
 #define DICTIONARY_H
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
+#include <deque>
 #include <iostream>
 #include <map>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 //#include "reader.h"
@@ -28,77 +32,134 @@ namespace hipo {
 class schema {
  private:
   std::map<std::string, std::pair<int, int> > schemaEntries;
-  std::vector<std::string> entryNames;
+  std::deque<std::string> entryNames;  // a deque, the index keys point into it
+
+  /* lookup tables, entryIndex gives the position of a name in entryNames
+     (keys are views of the names, so a lookup does not build a string),
+     itemTypes the type of every item id (0 when the item is not defined) */
+  std::unordered_map<std::string_view, int> entryIndex;
+  std::vector<int> entryItems;
+  std::vector<int> entryTypes;
+  int itemTypes[256];
 
   int groupid;
   std::string schemaName;
 
   /* internally used methods */
-  std::string getTypeString(int type);
-  std::string getRootTypeString(int type);
-  std::string getTypeStringSimple(int type);
-  int getMaxStringLength();
-  std::string getBranchVariable(const char* var, int max);
+  std::string getTypeString(int type) const;
+  std::string getRootTypeString(int type) const;
+  std::string getTypeStringSimple(int type) const;
+  int getMaxStringLength() const;
+  std::string getBranchVariable(const char* var, int max) const;
 
  public:
-  schema() { groupid = 0; }
-  schema(const char* name) { schemaName = name; }
-
-  schema(const schema& s) {
-    schemaName = s.schemaName;
-    schemaEntries = s.schemaEntries;
-    entryNames = s.entryNames;
-    groupid = s.groupid;
+  schema() {
+    groupid = 0;
+    std::fill(itemTypes, itemTypes + 256, 0);
+  }
+  schema(const char* name) {
+    schemaName = name;
+    groupid = 0;
+    std::fill(itemTypes, itemTypes + 256, 0);
   }
 
+  schema(const schema& s) { *this = s; }
+
   virtual ~schema() {}
 
   void setName(const char* name) { schemaName = name; }
-  std::string getName() { return schemaName; }
+  const std::string& getName() const { return schemaName; }
 
   void setGroup(int grp) { groupid = grp; }
-  bool hasEntry(const char* entry) { return schemaEntries.count(entry); }
+  bool hasEntry(const char* entry) const { return entryIndex.count(std::string_view(entry)) > 0; }
   void addEntry(const char* name, int id, int type) {
     schemaEntries[name] = std::make_pair(id, type);
     // printf(" adding entry %s\n",name);
     entryNames.push_back(name);
+    entryIndex[std::string_view(entryNames.back())] = entryNames.size() - 1;
+    entryItems.push_back(id);
+    entryTypes.push_back(type);
+    itemTypes[id & 0xFF] = type;
   }
 
-  int getGroup() { return groupid; };
-  int getItem(const char* entry);
-  int getType(const char* entry);
-  int getTypeByString(const char* typestring);
-  void ls();
-
-  std::vector<std::string> getEntryList();
-  std::vector<std::string> branchesCode();
-  std::vector<std::string> branchesAccessCode();
-
-  std::vector<std::string> getRootBranchesCode();
-  std::vector<std::string> getRootFillCode();
-
-  void operator=(const schema& D) {
+  int getGroup() const { return groupid; };
+  int getItem(const char* entry) const;
+  int getType(const char* entry) const;
+  /** type of an item id, 0 if the schema does not define it */
+  int getType(int item) const { return itemTypes[item & 0xFF]; }
+  /** position of the entry in getEntryList() order, -1 if not defined */
+  int getEntryOrder(const char* entry) const;
+  int getEntries() const { return entryNames.size(); }
+  const std::string& getEntryName(int order) const { return entryNames[order]; }
+  int getEntryItem(int order) const { return entryItems[order]; }
+  int getEntryType(int order) const { return entryTypes[order]; }
+  int getTypeByString(const char* typestring) const;
+  void ls() const;
+
+  std::vector<std::string> getEntryList() const;
+  std::vector<std::string> branchesCode() const;
+  std::vector<std::string> branchesAccessCode() const;
+  std::vector<std::string> bankStructCode() const;
+
+  std::vector<std::string> getRootBranchesCode() const;
+  std::vector<std::string> getRootFillCode() const;
+
+  schema& operator=(const schema& D) {
+    if (this == &D) return *this;
     schemaName = D.schemaName;
     groupid = D.groupid;
     schemaEntries = D.schemaEntries;
     entryNames = D.entryNames;
+    // the keys of D.entryIndex point into the names of D
+    entryIndex.clear();
+    for (int i = 0; i < entryNames.size(); i++) entryIndex[std::string_view(entryNames[i])] = i;
+    entryItems = D.entryItems;
+    entryTypes = D.entryTypes;
+    std::copy(D.itemTypes, D.itemTypes + 256, itemTypes);
+    return *this;
   }
 };
 
+/**
+ * schemas are stored once in a table and found either by name (hash)
+ * or by group id (direct index), lookups return references into the
+ * table so nothing is copied when binding branches. The table is a
+ * deque, references stay valid when more schemas are parsed. Names
+ * are interned once and the hash is keyed on views of them, so a
+ * lookup by name does not build a string.
+ */
 class dictionary {
  private:
-  std::map<std::string, hipo::schema> mapDict;
+  std::deque<hipo::schema> schemas;
+  std::deque<std::string> names;  // interned schema names, in schemas order
+  std::unordered_map<std::string_view, int> nameIndex;
+  std::vector<int> groupIndex;  // group id -> position in schemas, -1 if none
+
+  static const hipo::schema& emptySchema();
+  void buildNameIndex();
 
  public:
   dictionary() {}
+  dictionary(const dictionary& d) { *this = d; }
   virtual ~dictionary() {}
+  dictionary& operator=(const dictionary& d);
   // node(hipo::reader &reader, int group, int item);
   void ls(int mode = 0);
-  bool hasSchema(const char* name) { return mapDict.count(name) > 0; }
-  bool hasEntry(const char* name, const char* entry);
-  hipo::schema getSchema(const char* name) { return mapDict[name]; }
+  bool hasSchema(const char* name) const { return nameIndex.count(std::string_view(name)) > 0; }
+  bool hasSchema(int group) const { return group >= 0 && group < groupIndex.size() && groupIndex[group] >= 0; }
+  bool hasEntry(const char* name, const char* entry) const;
+  /** the schema with the given name, an empty schema if there is none */
+  const hipo::schema& getSchema(const char* name) const;
+  /** the schema of a group id, an empty schema if there is none */
+  const hipo::schema& getSchema(int group) const {
+    return hasSchema(group) ? schemas[groupIndex[group]] : emptySchema();
+  }
+  /** type of (group, item), 0 when it is not in the dictionary */
+  int getType(int group, int item) const { return hasSchema(group) ? schemas[groupIndex[group]].getType(item) : 0; }
   void parse(std::string dictString);
-  std::vector<std::string> getSchemaList();
+  std::vector<std::string> getSchemaList() const;
+  /** header with a typed accessor structure for every schema */
+  std::string getBanksCode();
 };
 
 }  // namespace hipo
@@ -5,6 +5,8 @@
  */
 
 #include "event.h"
+#include "hiposwap.h"
+#include "profiler.h"
 
 namespace hipo {
 
@@ -37,24 +39,27 @@ hipo::node<int> *event::getIntNode(int group, int item) {
 }
 
 void event::init(std::vector<char> &buffer) {
+  swapped = false;
   dataBuffer.resize(buffer.size());
   std::memcpy(&dataBuffer[0], &buffer[0], buffer.size());
   scanEvent();
 }
 
-void event::init(const char *buffer, int size) {
-  if (dataBuffer.size() <= size) {
-    dataBuffer.resize(size);
-  }
+void event::init(const char *buffer, int size, bool swap) {
+  profiler::resume(profiler::STAGE_SCAN);
+  swapped = swap;
+  hipo::fitBuffer(dataBuffer, size, 0);
   std::memcpy(&dataBuffer[0], buffer, size);
   *(reinterpret_cast<uint32_t *>(&dataBuffer[8])) = size;
+  if (swapped == true) swapPending.assign(size / 8 + 1, 1);
   scanEvent();
+  profiler::pause(profiler::STAGE_SCAN, size, 1);
 }
 
 void event::appendNode(int group, int item, std::string &vec) {
   int size = dataBuffer.size();
   int datasize = vec.length();
-  dataBuffer.resize(size + datasize + 8, 0);
+  dataBuffer.resize(size + datasize + 8);
   uint16_t *group_ptr = reinterpret_cast<uint16_t *>(&dataBuffer[size]);
   uint8_t *item_ptr = reinterpret_cast<uint8_t *>(&dataBuffer[size + 2]);
   uint8_t *type_ptr = reinterpret_cast<uint8_t *>(&dataBuffer[size + 3]);
@@ -69,6 +74,7 @@ void event::appendNode(int group, int item, std::string &vec) {
 void event::resetNodes() {
   for (int i = 0; i < nodes.size(); i++) {
     nodes[i]->length(0);
+    nodes[i]->setSwap(NULL);
   }
 }
 
@@ -76,7 +82,7 @@ void event::appendNode(int group, int item, std::vector<int8_t> &vec) {
   int size = dataBuffer.size();
   int datasize = vec.size() * sizeof(int8_t);
 
-  dataBuffer.resize(size + datasize + 8, 0);
+  dataBuffer.resize(size + datasize + 8);
   uint16_t *group_ptr = reinterpret_cast<uint16_t *>(&dataBuffer[size]);
   uint8_t *item_ptr = reinterpret_cast<uint8_t *>(&dataBuffer[size + 2]);
   uint8_t *type_ptr = reinterpret_cast<uint8_t *>(&dataBuffer[size + 3]);
@@ -92,7 +98,7 @@ void event::appendNode(int group, int item, std::vector<int16_t> &vec) {
   int size = dataBuffer.size();
   int datasize = vec.size() * sizeof(int16_t);
 
-  dataBuffer.resize(size + datasize + 8, 0);
+  dataBuffer.resize(size + datasize + 8);
   uint16_t *group_ptr = reinterpret_cast<uint16_t *>(&dataBuffer[size]);
   uint8_t *item_ptr = reinterpret_cast<uint8_t *>(&dataBuffer[size + 2]);
   uint8_t *type_ptr = reinterpret_cast<uint8_t *>(&dataBuffer[size + 3]);
@@ -108,7 +114,7 @@ void event::appendNode(int group, int item, std::vector<int> &vec) {
   int size = dataBuffer.size();
   int datasize = vec.size() * sizeof(int);
 
-  dataBuffer.resize(size + datasize + 8, 0);
+  dataBuffer.resize(size + datasize + 8);
   uint16_t *group_ptr = reinterpret_cast<uint16_t *>(&dataBuffer[size]);
   uint8_t *item_ptr = reinterpret_cast<uint8_t *>(&dataBuffer[size + 2]);
   uint8_t *type_ptr = reinterpret_cast<uint8_t *>(&dataBuffer[size + 3]);
@@ -124,7 +130,7 @@ void event::appendNode(int group, int item, std::vector<float> &vec) {
   int size = dataBuffer.size();
   int datasize = vec.size() * sizeof(float);
 
-  dataBuffer.resize(size + datasize + 8, 0);
+  dataBuffer.resize(size + datasize + 8);
   uint16_t *group_ptr = reinterpret_cast<uint16_t *>(&dataBuffer[size]);
   uint8_t *item_ptr = reinterpret_cast<uint8_t *>(&dataBuffer[size + 2]);
   uint8_t *type_ptr = reinterpret_cast<uint8_t *>(&dataBuffer[size + 3]);
@@ -137,6 +143,7 @@ void event::appendNode(int group, int item, std::vector<float> &vec) {
 }
 
 void event::reset() {
+  swapped = false;
   dataBuffer.resize(8);
   dataBuffer[0] = 'E';
   dataBuffer[1] = 'V';
@@ -148,10 +155,10 @@ int event::getEventNode(int group, int item) {
   int position = 16;
   int eventSize = *(reinterpret_cast<uint32_t *>(&dataBuffer[8]));
   while (position + 8 < eventSize) {
-    uint16_t gid = *(reinterpret_cast<uint16_t *>(&dataBuffer[position]));
+    uint16_t gid = nodeGroup(position);
     uint8_t iid = *(reinterpret_cast<uint8_t *>(&dataBuffer[position + 2]));
     uint8_t type = *(reinterpret_cast<uint8_t *>(&dataBuffer[position + 3]));
-    int length = *(reinterpret_cast<int *>(&dataBuffer[position + 4]));
+    int length = nodeLength(position);
     // printf("group = %4d , item = %4d\n",(unsigned int) gid, (unsigned int) iid);
     if (gid == group && iid == item) return position;
     position += (length + 8);
@@ -163,10 +170,11 @@ std::vector<long> event::getLong(int group, int item) {
   int position = getEventNode(group, item);
   std::vector<long> vector;
   if (position >= 0) {
-    uint16_t gid = *(reinterpret_cast<uint16_t *>(&dataBuffer[position]));
+    swapNode(position);
+    uint16_t gid = nodeGroup(position);
     uint8_t iid = *(reinterpret_cast<uint8_t *>(&dataBuffer[position + 2]));
     uint8_t type = *(reinterpret_cast<uint8_t *>(&dataBuffer[position + 3]));
-    int length = *(reinterpret_cast<int *>(&dataBuffer[position + 4]));
+    int length = nodeLength(position);
     if (type == 8) {
       int iter = length;
       for (int i = 0; i < iter; i++) {
@@ -182,10 +190,11 @@ std::vector<int> event::getInt(int group, int item) {
   int position = getEventNode(group, item);
   std::vector<int> vector;
   if (position >= 0) {
-    uint16_t gid = *(reinterpret_cast<uint16_t *>(&dataBuffer[position]));
+    swapNode(position);
+    uint16_t gid = nodeGroup(position);
     uint8_t iid = *(reinterpret_cast<uint8_t *>(&dataBuffer[position + 2]));
     uint8_t type = *(reinterpret_cast<uint8_t *>(&dataBuffer[position + 3]));
-    int length = *(reinterpret_cast<int *>(&dataBuffer[position + 4]));
+    int length = nodeLength(position);
 
     if (type == 1) {
       int iter = length;
@@ -219,10 +228,10 @@ std::string event::getString(int group, int item) {
   std::string result;
   int position = getEventNode(group, item);
   if (position >= 0) {
-    uint16_t gid = *(reinterpret_cast<uint16_t *>(&dataBuffer[position]));
+    uint16_t gid = nodeGroup(position);
     uint8_t iid = *(reinterpret_cast<uint8_t *>(&dataBuffer[position + 2]));
     uint8_t type = *(reinterpret_cast<uint8_t *>(&dataBuffer[position + 3]));
-    int length = *(reinterpret_cast<int *>(&dataBuffer[position + 4]));
+    int length = nodeLength(position);
     if (type == 6) {
       char *string_ch = (char *)malloc(length + 1);
       std::memcpy(string_ch, &dataBuffer[position + 8], length);
@@ -237,10 +246,11 @@ std::vector<float> event::getFloat(int group, int item) {
   int position = getEventNode(group, item);
   std::vector<float> vector;
   if (position >= 0) {
-    uint16_t gid = *(reinterpret_cast<uint16_t *>(&dataBuffer[position]));
+    swapNode(position);
+    uint16_t gid = nodeGroup(position);
     uint8_t iid = *(reinterpret_cast<uint8_t *>(&dataBuffer[position + 2]));
     uint8_t type = *(reinterpret_cast<uint8_t *>(&dataBuffer[position + 3]));
-    int length = *(reinterpret_cast<int *>(&dataBuffer[position + 4]));
+    int length = nodeLength(position);
     if (type == 4) {
       int iter = length / 4;
       for (int i = 0; i < iter; i++) {
@@ -283,10 +293,10 @@ void event::scanEvent() {
   int eventSize = *(reinterpret_cast<uint32_t *>(&dataBuffer[8]));
 
   while (position + 8 < eventSize) {
-    uint16_t gid = *(reinterpret_cast<uint16_t *>(&dataBuffer[position]));
+    uint16_t gid = nodeGroup(position);
     uint8_t iid = *(reinterpret_cast<uint8_t *>(&dataBuffer[position + 2]));
     uint8_t type = *(reinterpret_cast<uint8_t *>(&dataBuffer[position + 3]));
-    int length = *(reinterpret_cast<int *>(&dataBuffer[position + 4]));
+    int length = nodeLength(position);
     // printf("group = %4d , item = %4d\n",(unsigned int) gid, (unsigned int) iid);
     // if(gid==group&&iid==item) return position;
 
@@ -320,6 +330,8 @@ void event::scanEvent() {
       nodes[order]->type(type);
       nodes[order]->length(elements);
       nodes[order]->setAddress(&dataBuffer[position + 8]);
+      // the payload is swapped by the node on first access
+      if (swapped == true) nodes[order]->setSwap(&swapPending[position / 8]);
       // nodes[order]->address(&dataBuffer[position+8]);
 
       // printf(" found the key %d %d order = %d\n" , gid,iid, order);
@@ -338,10 +350,10 @@ void event::scanEventMap() {
   int eventSize = *(reinterpret_cast<uint32_t *>(&dataBuffer[8]));
 
   while (position + 8 < eventSize) {
-    uint16_t gid = *(reinterpret_cast<uint16_t *>(&dataBuffer[position]));
+    uint16_t gid = nodeGroup(position);
     uint8_t iid = *(reinterpret_cast<uint8_t *>(&dataBuffer[position + 2]));
     uint8_t type = *(reinterpret_cast<uint8_t *>(&dataBuffer[position + 3]));
-    int length = *(reinterpret_cast<int *>(&dataBuffer[position + 4]));
+    int length = nodeLength(position);
     // printf("group = %4d , item = %4d\n",(unsigned int) gid, (unsigned int) iid);
     // if(gid==group&&iid==item) return position;
     int key = ((0x00000000 | gid) << 16) | ((0x00000000 | iid) << 8);
@@ -354,14 +366,37 @@ void event::scanEventMap() {
   }
 }
 
+void event::getBankRows(std::vector<std::pair<int, int> > &rows) {
+  rows.clear();
+  int position = 16;
+  int eventSize = *(reinterpret_cast<uint32_t *>(&dataBuffer[8]));
+  int lastGroup = -1;
+  while (position + 8 < eventSize) {
+    int gid = nodeGroup(position);
+    if (gid != lastGroup) rows.push_back(std::make_pair(gid, getNodeSize(position)));
+    lastGroup = gid;
+    position += (nodeLength(position) + 8);
+  }
+}
+
+int event::getRows(int group) {
+  int position = 16;
+  int eventSize = *(reinterpret_cast<uint32_t *>(&dataBuffer[8]));
+  while (position + 8 < eventSize) {
+    if (nodeGroup(position) == group) return getNodeSize(position);
+    position += (nodeLength(position) + 8);
+  }
+  return 0;
+}
+
 int event::getNodeLength(int address) {
-  int length = *(reinterpret_cast<int *>(&dataBuffer[address + 4]));
+  int length = nodeLength(address);
   return length;
 }
 
 int event::getNodeSize(int address) {
   uint8_t type = *(reinterpret_cast<uint8_t *>(&dataBuffer[address + 3]));
-  int length = *(reinterpret_cast<int *>(&dataBuffer[address + 4]));
+  int length = nodeLength(address);
   switch (type) {
     case 2:
       return length / 2;
@@ -378,9 +413,34 @@ int event::getNodeSize(int address) {
   }
 }
 
-char *event::getNodePtr(int address) { return &dataBuffer[address + 8]; }
+char *event::getNodePtr(int address) {
+  swapNode(address);
+  return &dataBuffer[address + 8];
+}
+
+void event::swapNode(int position) {
+  if (swapped == false || swapPending[position / 8] == 0) return;
+  swapPending[position / 8] = 0;
+  int size = 0;
+  switch (dataBuffer[position + 3]) {
+    case 2:
+      size = 2;
+      break;
+    case 3:
+    case 4:
+      size = 4;
+      break;
+    case 5:
+    case 8:
+      size = 8;
+      break;
+    default:
+      return;
+  }
+  endian::swapArray(&dataBuffer[position + 8], nodeLength(position) / size, size);
+}
 
-std::vector<char> event::getEventBuffer() { return dataBuffer; }
+std::vector<char> event::getEventBuffer() { return std::vector<char>(dataBuffer.begin(), dataBuffer.end()); }
 /*
 template<class T>   node<T> event::getNode(){
     node<T> en;
@@ -21,6 +21,7 @@
 #include <iostream>
 #include <map>
 #include <vector>
+#include "buffer.h"
 #include "node.h"
 
 namespace hipo {
@@ -29,9 +30,30 @@ namespace hipo {
 
 class event {
  private:
-  std::vector<char> dataBuffer;
+  hipo::byteBuffer dataBuffer;
   std::map<int, int> eventNodes;
 
+  /**
+   * events from big endian files are kept as they are, the node
+   * headers are swapped when read and the payload of a node is swapped
+   * in place the first time it is handed out. swapPending has one flag
+   * per node, indexed by position / 8 (nodes are at least 8 bytes
+   * apart), set by init() while the payload is in file order.
+   */
+  bool swapped;
+  std::vector<uint8_t> swapPending;
+  int nodeGroup(int position) {
+    uint16_t gid;
+    std::memcpy(&gid, &dataBuffer[position], 2);
+    return swapped ? __builtin_bswap16(gid) : gid;
+  }
+  int nodeLength(int position) {
+    int length;
+    std::memcpy(&length, &dataBuffer[position + 4], 4);
+    return swapped ? (int)__builtin_bswap32(length) : length;
+  }
+  void swapNode(int position);
+
   std::map<int, int> registeredNodes;
   std::vector<hipo::generic_node *> nodes;
   // std::vector<std::auto_ptr<hipo::generic_node>> regiteredNodesPtr;
@@ -45,7 +67,7 @@ class event {
 
   void showInfo();
   void init(std::vector<char> &buffer);
-  void init(const char *buffer, int size);
+  void init(const char *buffer, int size, bool swapped = false);
 
   int getEventNode(int group, int item);
 
@@ -56,6 +78,8 @@ class event {
   void appendNode(int group, int item, std::string &vec);
 
   int getNodeAddress(int group, int item);
+  /** group of the node at address, in the byte order of the machine */
+  int getNodeGroup(int address) { return nodeGroup(address); }
   int getNodeType(int address);
   int getNodeLength(int address);
   int getNodeSize(int address);
@@ -73,9 +97,23 @@ class event {
   hipo::generic_node *getEventGenericBranch(int group, int item);
 
   std::vector<hipo::generic_node *> *getAllBranches() { return &nodes; }
+  /**
+   * raw event buffer, the nodes start at byte 16. On big endian files
+   * the node headers are not swapped, read them with getNodeGroup() and
+   * getNodeLength() and the payload with getNodePtr().
+   */
+  const char *getDataPtr() { return &dataBuffer[0]; }
+  int getDataSize() { return *(reinterpret_cast<uint32_t *>(&dataBuffer[8])); }
   // template<class T>   node<T> getNode();
   void scanEvent();
   void scanEventMap();
+  /**
+   * rows of every bank of the event as (group, rows) pairs, taken from
+   * the length of the first node of each group.
+   */
+  void getBankRows(std::vector<std::pair<int, int> > &rows);
+  /** rows of one bank group, 0 when it is not in the event */
+  int getRows(int group);
   std::vector<char> getEventBuffer();
   void reset();
 };
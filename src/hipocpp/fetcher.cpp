@@ -0,0 +1,316 @@
+/*
+ * Record read-ahead, see fetcher.h
+ */
+
+#include "fetcher.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define HIPO_URING
+#endif
+#endif
+
+namespace hipo {
+
+recordFetcher::recordFetcher() {
+  fileDescriptor = -1;
+  depth = 0;
+  backend = BACKEND_THREADS;
+  nextSubmit = 0;
+  nextDeliver = 0;
+  ringFd = -1;
+  sqRing = cqRing = sqeRing = NULL;
+  sqRingSize = cqRingSize = sqeRingSize = 0;
+  ringQueued = 0;
+  stopping = false;
+}
+
+recordFetcher::~recordFetcher() { close(); }
+
+bool recordFetcher::open(const char *filename, int d, int requested) {
+  close();
+  fileDescriptor = ::open(filename, O_RDONLY);
+  if (fileDescriptor < 0) {
+    printf("[FETCHER] ** error ** can not open file : %s\n", filename);
+    return false;
+  }
+  depth = (d > 0) ? d : 1;
+  slots.resize(depth);
+  for (int i = 0; i < depth; i++) slots[i].record = -1;
+  nextSubmit = 0;
+  nextDeliver = 0;
+
+  backend = BACKEND_THREADS;
+  if (requested != BACKEND_THREADS && setupRing() == true) backend = BACKEND_URING;
+  if (requested == BACKEND_URING && backend != BACKEND_URING)
+    printf("[FETCHER] io_uring is not available, using %d reader threads\n", depth);
+  if (backend == BACKEND_THREADS) startThreads(depth < 16 ? depth : 16);
+  return true;
+}
+
+void recordFetcher::close() {
+  if (fileDescriptor < 0) return;
+  // reads still in flight write into the slot buffers
+  for (int r = nextDeliver; r < nextSubmit; r++) waitSlot(r % depth);
+  if (backend == BACKEND_URING) closeRing();
+  if (backend == BACKEND_THREADS) stopThreads();
+  ::close(fileDescriptor);
+  fileDescriptor = -1;
+  records.clear();
+  slots.clear();
+}
+
+const char *recordFetcher::getBackend() { return (backend == BACKEND_URING) ? "io_uring" : "threads"; }
+
+void recordFetcher::setRecords(const std::vector<std::pair<long, long> > &list) {
+  seek(0);
+  records = list;
+}
+
+void recordFetcher::seek(int record) {
+  for (int r = nextDeliver; r < nextSubmit; r++) waitSlot(r % depth);
+  nextSubmit = record;
+  nextDeliver = record;
+}
+
+void recordFetcher::submit(int record) {
+  request &r = slots[record % depth];
+  r.record = record;
+  r.position = records[record].first;
+  r.length = records[record].second;
+  r.done = 0;
+  r.complete = false;
+  r.failed = false;
+  if (r.buffer.size() < r.length) r.buffer.resize(r.length);
+  if (backend == BACKEND_URING) {
+    queueRing(record % depth);
+  } else {
+    std::lock_guard<std::mutex> guard(lock);
+    pending.push_back(record % depth);
+    wakeup.notify_one();
+  }
+}
+
+void recordFetcher::waitSlot(int slot) {
+  if (backend == BACKEND_URING) {
+    while (slots[slot].complete == false) waitRing();
+  } else {
+    std::unique_lock<std::mutex> guard(lock);
+    while (slots[slot].complete == false) finished.wait(guard);
+  }
+}
+
+bool recordFetcher::next(hipo::byteBuffer &buffer) {
+  if (nextDeliver >= records.size()) return false;
+  while (nextSubmit < records.size() && nextSubmit < nextDeliver + depth) submit(nextSubmit++);
+
+  int slot = nextDeliver % depth;
+  waitSlot(slot);
+  request &r = slots[slot];
+  if (r.failed == true) {
+    printf("[FETCHER] ** error ** record at position %ld is incomplete\n", r.position);
+    seek(records.size());
+    return false;
+  }
+  buffer.swap(r.buffer);
+  buffer.resize(r.length);
+  r.record = -1;
+  nextDeliver++;
+  return true;
+}
+
+//----------------------------------------------------------------------
+// pread thread pool
+//----------------------------------------------------------------------
+
+/** reads the rest of a request, false on error or end of file */
+bool recordFetcher::readSlot(request &r) {
+  while (r.done < r.length) {
+    ssize_t n = pread(fileDescriptor, &r.buffer[r.done], r.length - r.done, r.position + r.done);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    r.done += n;
+  }
+  return true;
+}
+
+void recordFetcher::startThreads(int count) {
+  stopping = false;
+  for (int i = 0; i < count; i++) workers.push_back(std::thread(&recordFetcher::workerLoop, this));
+}
+
+void recordFetcher::stopThreads() {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  wakeup.notify_all();
+  for (int i = 0; i < workers.size(); i++) workers[i].join();
+  workers.clear();
+}
+
+void recordFetcher::workerLoop() {
+  while (true) {
+    int slot;
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      while (pending.empty() && stopping == false) wakeup.wait(guard);
+      if (pending.empty()) return;
+      slot = pending.front();
+      pending.pop_front();
+    }
+    bool status = readSlot(slots[slot]);
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      slots[slot].failed = !status;
+      slots[slot].complete = true;
+    }
+    finished.notify_all();
+  }
+}
+
+//----------------------------------------------------------------------
+// io_uring, the submission and completion rings are mapped directly
+//----------------------------------------------------------------------
+
+#ifdef HIPO_URING
+
+bool recordFetcher::setupRing() {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  ringFd = syscall(__NR_io_uring_setup, depth, &params);
+  if (ringFd < 0) return false;
+
+  sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    if (cqRingSize > sqRingSize) sqRingSize = cqRingSize;
+    cqRingSize = sqRingSize;
+  }
+  sqRing = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+  if (sqRing == MAP_FAILED) {
+    sqRing = NULL;
+    closeRing();
+    return false;
+  }
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    cqRing = sqRing;
+  } else {
+    cqRing = mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+    if (cqRing == MAP_FAILED) {
+      cqRing = NULL;
+      closeRing();
+      return false;
+    }
+  }
+  sqeRingSize = params.sq_entries * sizeof(struct io_uring_sqe);
+  sqeRing = mmap(NULL, sqeRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+  if (sqeRing == MAP_FAILED) {
+    sqeRing = NULL;
+    closeRing();
+    return false;
+  }
+
+  char *sq = (char *)sqRing;
+  char *cq = (char *)cqRing;
+  sqHead = (unsigned *)(sq + params.sq_off.head);
+  sqTail = (unsigned *)(sq + params.sq_off.tail);
+  sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+  sqArray = (unsigned *)(sq + params.sq_off.array);
+  cqHead = (unsigned *)(cq + params.cq_off.head);
+  cqTail = (unsigned *)(cq + params.cq_off.tail);
+  cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+  cqes = cq + params.cq_off.cqes;
+  ringQueued = 0;
+  return true;
+}
+
+void recordFetcher::closeRing() {
+  if (sqeRing != NULL) munmap(sqeRing, sqeRingSize);
+  if (cqRing != NULL && cqRing != sqRing) munmap(cqRing, cqRingSize);
+  if (sqRing != NULL) munmap(sqRing, sqRingSize);
+  if (ringFd >= 0) ::close(ringFd);
+  sqRing = cqRing = sqeRing = NULL;
+  ringFd = -1;
+}
+
+/** prepares the read of the rest of a slot, submitted with the next wait */
+void recordFetcher::queueRing(int slot) {
+  request &r = slots[slot];
+  unsigned tail = *sqTail;
+  unsigned index = tail & *sqMask;
+  struct io_uring_sqe *sqe = ((struct io_uring_sqe *)sqeRing) + index;
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = fileDescriptor;
+  sqe->addr = (unsigned long)&r.buffer[r.done];
+  sqe->len = r.length - r.done;
+  sqe->off = r.position + r.done;
+  sqe->user_data = slot;
+  sqArray[index] = index;
+  __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+  ringQueued++;
+}
+
+/** submits the prepared reads and handles at least one completion */
+void recordFetcher::waitRing() {
+  int status = syscall(__NR_io_uring_enter, ringFd, ringQueued, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+  if (status < 0 && errno != EINTR) {
+    // the ring is unusable, finish the outstanding reads synchronously
+    for (int i = 0; i < depth; i++) {
+      if (slots[i].record >= 0 && slots[i].complete == false) {
+        slots[i].failed = !readSlot(slots[i]);
+        slots[i].complete = true;
+      }
+    }
+    return;
+  }
+  if (status >= 0) ringQueued -= status;
+
+  unsigned head = *cqHead;
+  while (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+    struct io_uring_cqe *cqe = ((struct io_uring_cqe *)cqes) + (head & *cqMask);
+    request &r = slots[cqe->user_data];
+    int result = cqe->res;
+    head++;
+    __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+
+    if (result == -EINTR || result == -EAGAIN) {
+      queueRing(&r - &slots[0]);
+    } else if (result < 0) {
+      // e.g. IORING_OP_READ not supported by this kernel
+      r.failed = !readSlot(r);
+      r.complete = true;
+    } else if (result == 0) {
+      r.failed = true;
+      r.complete = true;
+    } else {
+      r.done += result;
+      if (r.done < r.length)
+        queueRing(&r - &slots[0]);
+      else
+        r.complete = true;
+    }
+  }
+}
+
+#else
+
+bool recordFetcher::setupRing() { return false; }
+void recordFetcher::closeRing() {}
+void recordFetcher::queueRing(int slot) {}
+void recordFetcher::waitRing() {}
+
+#endif
+
+}  // namespace hipo
@@ -0,0 +1,113 @@
+/*
+ * File:   fetcher.h
+ *
+ * Read-ahead of whole records. The positions and lengths of the
+ * records are known from the record index, the fetcher keeps up to
+ * depth reads in flight and hands the buffers out in file order.
+ * Reads go through io_uring (raw system calls, no liburing needed)
+ * when the kernel allows it, otherwise through a pool of threads
+ * doing pread().
+ */
+
+#ifndef HIPO_FETCHER_H
+#define HIPO_FETCHER_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "buffer.h"
+
+namespace hipo {
+
+class recordFetcher {
+ public:
+  enum backend_t { BACKEND_AUTO = 0, BACKEND_URING, BACKEND_THREADS };
+
+ private:
+  struct request {
+    int record;  // index in the record list
+    long position;
+    long length;
+    long done;  // bytes read so far
+    bool complete;
+    bool failed;
+    hipo::byteBuffer buffer;
+  };
+
+  int fileDescriptor;
+  int depth;
+  int backend;
+  std::vector<std::pair<long, long> > records;  // position and length in bytes
+  std::vector<request> slots;                   // record i is read into slots[i % depth]
+  int nextSubmit;
+  int nextDeliver;
+
+  /* io_uring */
+  int ringFd;
+  void *sqRing;
+  void *cqRing;
+  void *sqeRing;
+  size_t sqRingSize;
+  size_t cqRingSize;
+  size_t sqeRingSize;
+  unsigned *sqHead;
+  unsigned *sqTail;
+  unsigned *sqMask;
+  unsigned *sqArray;
+  unsigned *cqHead;
+  unsigned *cqTail;
+  unsigned *cqMask;
+  void *cqes;
+  int ringQueued;  // prepared but not yet submitted
+
+  bool setupRing();
+  void closeRing();
+  void queueRing(int slot);
+  void waitRing();
+
+  /* thread pool */
+  std::vector<std::thread> workers;
+  std::mutex lock;
+  std::condition_variable wakeup;
+  std::condition_variable finished;
+  std::deque<int> pending;
+  bool stopping;
+
+  void startThreads(int count);
+  void stopThreads();
+  void workerLoop();
+  bool readSlot(request &r);
+
+  void submit(int record);
+  void waitSlot(int slot);
+
+ public:
+  recordFetcher();
+  ~recordFetcher();
+
+  /** opens the file for reading with up to depth records in flight */
+  bool open(const char *filename, int depth, int backend = BACKEND_AUTO);
+  void close();
+
+  void setRecords(const std::vector<std::pair<long, long> > &list);
+  /** drops the reads in flight and continues at the given record */
+  void seek(int record);
+  int getNextRecord() { return nextDeliver; }
+
+  /**
+   * moves the next record in file order into buffer (the previous
+   * content of buffer is reused for later reads). Returns false at the
+   * end of the list or when the record could not be read completely.
+   */
+  bool next(hipo::byteBuffer &buffer);
+
+  const char *getBackend();
+};
+
+}  // namespace hipo
+
+#endif /* HIPO_FETCHER_H */
@@ -0,0 +1,122 @@
+/*
+ * File:   hiposwap.h
+ *
+ * Byte order helpers for files written on big endian machines. The
+ * decoding code is instantiated for both byte orders (template
+ * argument swapped) so the little endian path has no per word tests.
+ * Array swaps and the record index conversion work on four words at
+ * a time with SSE2 (SSSE3 when the compiler allows it), with a scalar
+ * loop for the rest and for other architectures.
+ */
+
+#ifndef HIPO_SWAP_H
+#define HIPO_SWAP_H
+
+#include <stdint.h>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+namespace hipo {
+namespace endian {
+
+/** signature word of a record or file header read with the wrong byte order */
+const int SWAPPED_MAGIC = 0x0001dac0;
+
+template <bool swapped>
+inline int32_t load32(const char *ptr) {
+  int32_t value;
+  std::memcpy(&value, ptr, 4);
+  return swapped ? (int32_t)__builtin_bswap32(value) : value;
+}
+
+template <bool swapped>
+inline uint16_t load16(const char *ptr) {
+  uint16_t value;
+  std::memcpy(&value, ptr, 2);
+  return swapped ? __builtin_bswap16(value) : value;
+}
+
+#if defined(__SSE2__)
+inline __m128i swapVector16(__m128i v) { return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)); }
+
+inline __m128i swapVector32(__m128i v) {
+#if defined(__SSSE3__)
+  return _mm_shuffle_epi8(v, _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3));
+#else
+  v = swapVector16(v);
+  return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xB1), 0xB1);
+#endif
+}
+
+inline __m128i swapVector64(__m128i v) { return _mm_shuffle_epi32(swapVector32(v), 0xB1); }
+#endif
+
+/** swaps count elements of size bytes (2, 4 or 8) in place */
+inline void swapArray(char *data, long count, int size) {
+  long i = 0;
+#if defined(__SSE2__)
+  long perVector = 16 / size;
+  for (; i + perVector <= count; i += perVector) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i * size));
+    v = (size == 2) ? swapVector16(v) : (size == 4) ? swapVector32(v) : swapVector64(v);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(data + i * size), v);
+  }
+#endif
+  for (; i < count; i++) {
+    char *p = data + i * size;
+    if (size == 2) {
+      uint16_t v;
+      std::memcpy(&v, p, 2);
+      v = __builtin_bswap16(v);
+      std::memcpy(p, &v, 2);
+    } else if (size == 4) {
+      uint32_t v;
+      std::memcpy(&v, p, 4);
+      v = __builtin_bswap32(v);
+      std::memcpy(p, &v, 4);
+    } else if (size == 8) {
+      uint64_t v;
+      std::memcpy(&v, p, 8);
+      v = __builtin_bswap64(v);
+      std::memcpy(p, &v, 8);
+    }
+  }
+}
+
+/**
+ * converts the record index from event lengths to end positions in
+ * place (inclusive prefix sum), swapping the lengths first if needed.
+ */
+template <bool swapped>
+inline void lengthsToOffsets(char *index, int count) {
+  int i = 0;
+  int32_t position = 0;
+#if defined(__SSE2__)
+  __m128i carry = _mm_setzero_si128();
+  for (; i + 4 <= count; i += 4) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(index + i * 4));
+    if (swapped) v = swapVector32(v);
+    v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+    v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+    v = _mm_add_epi32(v, carry);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(index + i * 4), v);
+    carry = _mm_shuffle_epi32(v, 0xFF);
+  }
+  position = _mm_cvtsi128_si32(carry);
+#endif
+  for (; i < count; i++) {
+    position += load32<swapped>(index + i * 4);
+    std::memcpy(index + i * 4, &position, 4);
+  }
+}
+
+}  // namespace endian
+}  // namespace hipo
+
+#endif /* HIPO_SWAP_H */
@@ -0,0 +1,253 @@
+/*
+ * LUND event file reader, see lund.h
+ */
+
+#include "lund.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <charconv>
+#include <cstring>
+#include <thread>
+
+namespace text {
+
+void lundColumns::clear() {
+  offsets.clear();
+  weight.clear();
+  beamEnergy.clear();
+  ltime.clear();
+  type.clear();
+  pid.clear();
+  parent.clear();
+  daughter.clear();
+  px.clear();
+  py.clear();
+  pz.clear();
+  energy.clear();
+  mass.clear();
+  vx.clear();
+  vy.clear();
+  vz.clear();
+}
+
+/**
+ * number parsing in place, p is moved past the number. Leading
+ * blanks and a '+' sign are skipped, false when there is no number
+ * before the end of the line.
+ */
+template <class T>
+static inline bool parseValue(const char *&p, const char *end, T &value) {
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+  if (p < end && *p == '+') p++;
+  std::from_chars_result result = std::from_chars(p, end, value);
+  if (result.ec != std::errc()) return false;
+  p = result.ptr;
+  return true;
+}
+
+static inline const char *lineEnd(const char *p, const char *end) {
+  const char *eol = (const char *)memchr(p, '\n', end - p);
+  return (eol == NULL) ? end : eol;
+}
+
+lund::lund() {
+  fileDescriptor = -1;
+  data = NULL;
+  dataSize = 0;
+  position = 0;
+  nThreads = 0;
+  chunkSize = 8 * 1024 * 1024;
+  currentChunk = 0;
+  currentEvent = -1;
+  setThreads(0);
+}
+
+lund::~lund() { close(); }
+
+void lund::setThreads(int threads) {
+  nThreads = threads;
+  if (nThreads <= 0) nThreads = std::thread::hardware_concurrency();
+  if (nThreads <= 0) nThreads = 1;
+}
+
+bool lund::open(const char *filename) {
+  close();
+  fileDescriptor = ::open(filename, O_RDONLY);
+  if (fileDescriptor < 0) {
+    printf("[LUND] ** error ** can not open file : %s\n", filename);
+    return false;
+  }
+  struct stat info;
+  fstat(fileDescriptor, &info);
+  dataSize = info.st_size;
+  if (dataSize > 0) {
+    void *mapped = mmap(NULL, dataSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    if (mapped == MAP_FAILED) {
+      printf("[LUND] ** error ** can not map file : %s\n", filename);
+      close();
+      return false;
+    }
+    data = (const char *)mapped;
+    madvise(mapped, dataSize, MADV_SEQUENTIAL);
+  }
+  position = 0;
+  chunks.clear();
+  currentChunk = 0;
+  currentEvent = -1;
+  return true;
+}
+
+void lund::close() {
+  if (data != NULL) munmap((void *)data, dataSize);
+  if (fileDescriptor >= 0) ::close(fileDescriptor);
+  data = NULL;
+  dataSize = 0;
+  fileDescriptor = -1;
+}
+
+/**
+ * returns the position after skipping count lines, blank lines
+ * are not counted.
+ */
+size_t lund::skipLines(size_t pos, int count) {
+  const char *end = data + dataSize;
+  const char *p = data + pos;
+  while (count > 0 && p < end) {
+    const char *eol = lineEnd(p, end);
+    const char *c = p;
+    while (c < eol && (*c == ' ' || *c == '\t' || *c == '\r')) c++;
+    if (c < eol) count--;
+    p = (eol < end) ? eol + 1 : end;
+  }
+  return p - data;
+}
+
+/**
+ * walks over whole events starting at start until the chunk is
+ * at least chunkSize long. Only the particle count of each header is
+ * parsed here, the rest is skipped line by line.
+ */
+size_t lund::findChunkEnd(size_t start) {
+  const char *end = data + dataSize;
+  size_t pos = start;
+  while (pos < dataSize && pos - start < chunkSize) {
+    const char *p = data + pos;
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) p++;
+    if (p >= end) return dataSize;
+    int particles = 0;
+    if (!parseValue(p, end, particles)) return skipLines(p - data, 1);
+    pos = skipLines(p - data, particles + 1);
+  }
+  return pos;
+}
+
+void lund::parseChunk(size_t start, size_t end, lundColumns &columns, std::string &error) {
+  columns.clear();
+  columns.offsets.push_back(0);
+  const char *p = data + start;
+  const char *last = data + end;
+  while (p < last) {
+    while (p < last && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) p++;
+    if (p >= last) break;
+
+    const char *eol = lineEnd(p, last);
+    int particles = 0;
+    float header[10];
+    int nheader = 0;
+    if (!parseValue(p, eol, particles)) {
+      error = "bad event header : " + std::string(p, eol - p);
+      return;
+    }
+    while (nheader < 10 && parseValue(p, eol, header[nheader])) nheader++;
+    columns.beamEnergy.push_back(nheader >= 6 ? header[5] : 0);
+    columns.weight.push_back(nheader >= 9 ? header[8] : 1);
+    p = (eol < last) ? eol + 1 : last;
+
+    for (int i = 0; i < particles; i++) {
+      while (p < last && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) p++;
+      eol = lineEnd(p, last);
+      int index, type, pid, parent, daughter;
+      float ltime, px, py, pz, energy, mass, vx, vy, vz;
+      bool ok = parseValue(p, eol, index) && parseValue(p, eol, ltime) && parseValue(p, eol, type) &&
+                parseValue(p, eol, pid) && parseValue(p, eol, parent) && parseValue(p, eol, daughter) &&
+                parseValue(p, eol, px) && parseValue(p, eol, py) && parseValue(p, eol, pz) &&
+                parseValue(p, eol, energy) && parseValue(p, eol, mass) && parseValue(p, eol, vx) &&
+                parseValue(p, eol, vy) && parseValue(p, eol, vz);
+      if (!ok) {
+        error = "bad particle line : " + std::string(p, eol - p);
+        return;
+      }
+      columns.ltime.push_back(ltime);
+      columns.type.push_back(type);
+      columns.pid.push_back(pid);
+      columns.parent.push_back(parent);
+      columns.daughter.push_back(daughter);
+      columns.px.push_back(px);
+      columns.py.push_back(py);
+      columns.pz.push_back(pz);
+      columns.energy.push_back(energy);
+      columns.mass.push_back(mass);
+      columns.vx.push_back(vx);
+      columns.vy.push_back(vy);
+      columns.vz.push_back(vz);
+      p = (eol < last) ? eol + 1 : last;
+    }
+    columns.offsets.push_back(columns.pid.size());
+  }
+}
+
+/**
+ * cuts the next nThreads chunks and parses them in parallel,
+ * false when the file is finished.
+ */
+bool lund::readChunks() {
+  if (position >= dataSize) return false;
+  std::vector<size_t> bounds;
+  bounds.push_back(position);
+  while (bounds.size() <= nThreads && bounds.back() < dataSize) bounds.push_back(findChunkEnd(bounds.back()));
+  position = bounds.back();
+
+  int n = bounds.size() - 1;
+  chunks.resize(n);
+  errors.assign(n, "");
+  std::vector<std::thread> workers;
+  for (int i = 1; i < n; i++) {
+    workers.push_back(std::thread(&lund::parseChunk, this, bounds[i], bounds[i + 1], std::ref(chunks[i]),
+                                  std::ref(errors[i])));
+  }
+  parseChunk(bounds[0], bounds[1], chunks[0], errors[0]);
+  for (int i = 0; i < workers.size(); i++) workers[i].join();
+
+  for (int i = 0; i < n; i++) {
+    if (errors[i].size() > 0) {
+      printf("[LUND] ** error ** %s\n", errors[i].c_str());
+      position = dataSize;
+      chunks.resize(i + 1);
+      break;
+    }
+  }
+  currentChunk = 0;
+  currentEvent = -1;
+  return true;
+}
+
+bool lund::next() {
+  while (true) {
+    if (currentChunk < chunks.size() && currentEvent + 1 < chunks[currentChunk].getEvents()) {
+      currentEvent++;
+      return true;
+    }
+    if (currentChunk + 1 < chunks.size()) {
+      currentChunk++;
+      currentEvent = -1;
+      continue;
+    }
+    if (!readChunks()) return false;
+  }
+}
+
+}  // namespace text
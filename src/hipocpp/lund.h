@@ -0,0 +1,98 @@
+/*
+ * File:   lund.h
+ *
+ * Fast reader for LUND event files (generator output). The file is
+ * memory mapped, cut into chunks on event boundaries and the chunks
+ * are parsed in parallel straight into columns with from_chars, no
+ * line strings or token vectors are built.
+ *
+ * Each event is a header line (number of particles first, 10 values)
+ * followed by one line per particle with 14 values:
+ *   index lifetime type pid parent daughter px py pz E mass vx vy vz
+ */
+
+#ifndef HIPO_LUND_H
+#define HIPO_LUND_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace text {
+
+/**
+ * Columns of the particles of a run of consecutive events, the
+ * particles of event i are the rows offsets[i] to offsets[i+1]-1.
+ */
+class lundColumns {
+ public:
+  std::vector<int> offsets;
+  std::vector<float> weight;  // last value of the event header
+  std::vector<float> beamEnergy;
+
+  std::vector<float> ltime;
+  std::vector<int> type;
+  std::vector<int> pid;
+  std::vector<int> parent;
+  std::vector<int> daughter;
+  std::vector<float> px;
+  std::vector<float> py;
+  std::vector<float> pz;
+  std::vector<float> energy;
+  std::vector<float> mass;
+  std::vector<float> vx;
+  std::vector<float> vy;
+  std::vector<float> vz;
+
+  void clear();
+  int getEvents() { return offsets.size() > 0 ? offsets.size() - 1 : 0; }
+};
+
+class lund {
+ private:
+  int fileDescriptor;
+  const char *data;
+  size_t dataSize;
+  size_t position;  // start of the first event not cut into a chunk yet
+
+  int nThreads;
+  size_t chunkSize;
+  std::vector<lundColumns> chunks;
+  std::vector<std::string> errors;
+  int currentChunk;
+  int currentEvent;
+
+  size_t skipLines(size_t pos, int count);
+  size_t findChunkEnd(size_t start);
+  void parseChunk(size_t start, size_t end, lundColumns &columns, std::string &error);
+  bool readChunks();
+
+ public:
+  lund();
+  ~lund();
+
+  bool open(const char *filename);
+  void close();
+
+  /** number of parser threads, 0 = all cores */
+  void setThreads(int threads);
+  /** bytes of text given to one thread at a time */
+  void setChunkSize(size_t size) { chunkSize = size; }
+
+  /** moves to the next event, false at the end of the file */
+  bool next();
+
+  /** columns holding the current event, its rows start at getFirst() */
+  lundColumns &getColumns() { return chunks[currentChunk]; }
+  int getFirst() { return chunks[currentChunk].offsets[currentEvent]; }
+  int getRows() {
+    return chunks[currentChunk].offsets[currentEvent + 1] - chunks[currentChunk].offsets[currentEvent];
+  }
+  float getWeight() { return chunks[currentChunk].weight[currentEvent]; }
+  float getBeamEnergy() { return chunks[currentChunk].beamEnergy[currentEvent]; }
+};
+
+}  // namespace text
+
+#endif /* HIPO_LUND_H */
@@ -12,9 +12,33 @@
 
 #include "node.h"
 
+#include "hiposwap.h"
+
 namespace hipo {
 
-generic_node::generic_node() {}
+generic_node::generic_node() { __swap = NULL; }
+
+void generic_node::swapPayload(char *address) {
+  int size = 0;
+  switch (__type) {
+    case 2:
+      size = 2;
+      break;
+    case 3:
+    case 4:
+      size = 4;
+      break;
+    case 5:
+    case 8:
+      size = 8;
+      break;
+    default:
+      break;
+  }
+  if (*__swap != 0 && size > 0) endian::swapArray(address, __length, size);
+  *__swap = 0;
+  __swap = NULL;
+}
 
 generic_node::~generic_node() { /*---- Nothing to destory ---*/ }
 
@@ -14,6 +14,7 @@
 #ifndef NODE_H
 #define NODE_H
 
+#include <stdint.h>
 #include <cstdio>
 #include <cstdlib>
 #include <iostream>
@@ -30,18 +31,36 @@ class generic_node {
   int __type;
   int __length;
   char *__address;
+  uint8_t *__swap;
   std::string __node_name;
 
+ protected:
+  /**
+   * payload of a big endian file that is swapped on first access, the
+   * flag is owned by the event and shared with event::getNodePtr() so a
+   * node is swapped only once.
+   */
+  void swapPayload(char *address);
+  void checkSwap(char *address) {
+    if (__swap != NULL) swapPayload(address);
+  }
+
  public:
   generic_node();
   generic_node(int group, int item) {
     __group_id = group;
     __item_id = item;
+    __swap = NULL;
   }
   virtual ~generic_node();
 
   virtual void setAddress(char *address) { __address = address; }
-  virtual char *getAddress() { return __address; }
+  virtual char *getAddress() {
+    checkSwap(__address);
+    return __address;
+  }
+  /** flag of the event set while the payload is still in file order, NULL when it is not */
+  void setSwap(uint8_t *flag) { __swap = flag; }
   int type();
   int length();
   int group();
@@ -143,6 +162,7 @@ int node<T>::getBytesLength() {
 }
 template <class T>
 T node<T>::getValue(int index) {
+  checkSwap(reinterpret_cast<char *>(ptr));
   return ptr[index];
 }
 
@@ -158,6 +178,7 @@ void node<T>::show() {
 
 template <class T>
 char *node<T>::getAddress() {
+  checkSwap(reinterpret_cast<char *>(ptr));
   return reinterpret_cast<char *>(ptr);
 }
 
@@ -0,0 +1,180 @@
+/*
+ * Per-stage timing and counters, see profiler.h
+ */
+
+#include "profiler.h"
+
+#include <mutex>
+
+namespace hipo {
+
+std::atomic<bool> profiler::profileEnabled(false);
+
+namespace {
+/** stage names and parents, the live thread slots and the totals of finished threads */
+struct registry {
+  std::mutex lock;
+  std::vector<std::string> names;
+  std::vector<int> parents;
+  std::vector<void *> slots;
+  std::vector<benchmark> finished;
+  registry() {
+    const char *library[] = {"io", "decompress", "index", "scan", "record index"};
+    for (int i = 0; i < profiler::STAGE_LIBRARY_MAX; i++) {
+      names.push_back(library[i]);
+      parents.push_back(-1);
+      finished.push_back(benchmark(library[i]));
+    }
+  }
+};
+
+registry &stages() {
+  // never destroyed, threads can exit during static destruction
+  static registry *instance = new registry();
+  return *instance;
+}
+}  // namespace
+
+profiler::slot::slot() {
+  reset();
+  registry &r = stages();
+  std::lock_guard<std::mutex> guard(r.lock);
+  r.slots.push_back(this);
+}
+
+profiler::slot::~slot() {
+  registry &r = stages();
+  std::lock_guard<std::mutex> guard(r.lock);
+  for (int i = 0; i < r.finished.size(); i++) {
+    r.finished[i].addTime(time[i].load(std::memory_order_relaxed), counter[i].load(std::memory_order_relaxed));
+    r.finished[i].addBytes(bytes[i].load(std::memory_order_relaxed));
+    r.finished[i].addEvents(events[i].load(std::memory_order_relaxed));
+  }
+  for (int i = 0; i < r.slots.size(); i++) {
+    if (r.slots[i] == this) {
+      r.slots.erase(r.slots.begin() + i);
+      break;
+    }
+  }
+}
+
+void profiler::slot::reset() {
+  for (int i = 0; i < MAX_STAGES; i++) {
+    time[i].store(0, std::memory_order_relaxed);
+    counter[i].store(0, std::memory_order_relaxed);
+    bytes[i].store(0, std::memory_order_relaxed);
+    events[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+void profiler::enable(bool flag) {
+  registry &r = stages();
+  std::lock_guard<std::mutex> guard(r.lock);
+  for (int i = 0; i < r.slots.size(); i++) static_cast<slot *>(r.slots[i])->reset();
+  for (int i = 0; i < r.finished.size(); i++) r.finished[i].reset();
+  profileEnabled.store(flag);
+}
+
+int profiler::addStage(const char *name) {
+  registry &r = stages();
+  std::lock_guard<std::mutex> guard(r.lock);
+  for (int i = 0; i < r.names.size(); i++) {
+    if (r.names[i] == name) return i;
+  }
+  if (r.names.size() >= MAX_STAGES) {
+    printf("[PROFILER] ** error ** no room for stage %s (%d stages)\n", name, MAX_STAGES);
+    return -1;
+  }
+  r.names.push_back(name);
+  r.parents.push_back(-1);
+  r.finished.push_back(benchmark(name));
+  return r.names.size() - 1;
+}
+
+void profiler::setParent(int stage, int parent) {
+  registry &r = stages();
+  std::lock_guard<std::mutex> guard(r.lock);
+  if (stage >= 0 && stage < r.parents.size() && parent < (int)r.parents.size() && parent != stage)
+    r.parents[stage] = parent;
+}
+
+benchmark profiler::getStage(int stage) {
+  registry &r = stages();
+  std::lock_guard<std::mutex> guard(r.lock);
+  if (stage < 0 || stage >= r.finished.size()) return benchmark();
+  benchmark total = r.finished[stage];
+  for (int i = 0; i < r.slots.size(); i++) {
+    slot *s = static_cast<slot *>(r.slots[i]);
+    total.addTime(s->time[stage].load(std::memory_order_relaxed), s->counter[stage].load(std::memory_order_relaxed));
+    total.addBytes(s->bytes[stage].load(std::memory_order_relaxed));
+    total.addEvents(s->events[stage].load(std::memory_order_relaxed));
+  }
+  return total;
+}
+
+namespace {
+/** stages in display order, each followed by the ones that are part of it */
+void displayOrder(const std::vector<int> &parents, int parent, int depth, std::vector<std::pair<int, int> > &order) {
+  for (int i = 0; i < parents.size(); i++) {
+    if (parents[i] != parent) continue;
+    order.push_back(std::make_pair(i, depth));
+    displayOrder(parents, i, depth + 1, order);
+  }
+}
+}  // namespace
+
+/**
+ * prints the breakdown table, the fraction is given relative
+ * to the wall time provided by the caller. Stages that are part of
+ * another one are indented under it.
+ */
+void profiler::show(double wallTime) {
+  std::vector<int> parents;
+  {
+    std::lock_guard<std::mutex> guard(stages().lock);
+    parents = stages().parents;
+  }
+  std::vector<std::pair<int, int> > order;
+  displayOrder(parents, -1, 0, order);
+  printf("+----------------------+------------+--------+------------+------------+------------+\n");
+  printf("| %-20s | %10s | %6s | %10s | %10s | %10s |\n", "stage", "time (s)", "%", "calls", "MB", "events");
+  printf("+----------------------+------------+--------+------------+------------+------------+\n");
+  for (int i = 0; i < order.size(); i++) {
+    benchmark stage = getStage(order[i].first);
+    std::string name = std::string(2 * order[i].second, ' ') + stage.getName();
+    double fraction = (wallTime > 0) ? 100.0 * stage.getTimeSec() / wallTime : 0.0;
+    printf("| %-20s | %10.3f | %6.2f | %10ld | %10.2f | %10ld |\n", name.c_str(), stage.getTimeSec(), fraction,
+           stage.getCounter(), stage.getBytes() / 1024.0 / 1024.0, stage.getEvents());
+  }
+  printf("+----------------------+------------+--------+------------+------------+------------+\n");
+  printf("| %-20s | %10.3f |\n", "wall time", wallTime);
+  printf("+----------------------+------------+\n");
+  printf("  indented stages are part of the stage above them\n");
+}
+/**
+ * returns the same numbers as show() as a single line JSON object,
+ * a stage that is part of another one has its name as "parent".
+ */
+std::string profiler::getJson(double wallTime) {
+  std::vector<int> parents;
+  {
+    std::lock_guard<std::mutex> guard(stages().lock);
+    parents = stages().parents;
+  }
+  std::string json;
+  char line[512];
+  snprintf(line, sizeof(line), "{\"wall_time\":%.6f,\"stages\":[", wallTime);
+  json.append(line);
+  for (int i = 0; i < parents.size(); i++) {
+    benchmark stage = getStage(i);
+    std::string parent = (parents[i] >= 0) ? std::string(",\"parent\":\"") + getStage(parents[i]).getName() + "\"" : "";
+    snprintf(line, sizeof(line), "%s{\"name\":\"%s\",\"time\":%.6f,\"calls\":%ld,\"bytes\":%ld,\"events\":%ld%s}",
+             (i > 0) ? "," : "", stage.getName(), stage.getTimeSec(), stage.getCounter(), stage.getBytes(),
+             stage.getEvents(), parent.c_str());
+    json.append(line);
+  }
+  json.append("]}");
+  return json;
+}
+
+}  // namespace hipo
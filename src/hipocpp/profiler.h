@@ -0,0 +1,159 @@
+/*
+ * File:   profiler.h
+ *
+ * Lightweight per-stage timing and counters used to find out where
+ * the time goes when reading HIPO files (I/O, decompression, event
+ * scanning) and in applications built on top of the library.
+ * The instrumentation is always compiled in, but every call returns
+ * immediately unless profiling was enabled with profiler::enable().
+ * Records are decoded on several threads (reader threads, foreach
+ * record), so every thread accumulates into its own slot and the
+ * slots are added up when the numbers are shown.
+ */
+
+#ifndef HIPO_PROFILER_H
+#define HIPO_PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace hipo {
+
+/**
+ * benchmark accumulates the time spent in one stage along with
+ * the number of times the stage was entered and the number of
+ * bytes and events it processed.
+ */
+class benchmark {
+ private:
+  std::chrono::steady_clock::time_point clockStart;
+  long runningTime;
+  long counter;
+  long bytes;
+  long events;
+  std::string benchmarkName;
+
+ public:
+  benchmark() { reset(); }
+  benchmark(const char *name) {
+    benchmarkName = name;
+    reset();
+  }
+  ~benchmark() {}
+
+  void setName(const char *name) { benchmarkName = name; }
+  const char *getName() { return benchmarkName.c_str(); }
+
+  void reset() {
+    runningTime = 0;
+    counter = 0;
+    bytes = 0;
+    events = 0;
+  }
+  void resume() { clockStart = std::chrono::steady_clock::now(); }
+  void pause() {
+    runningTime += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - clockStart)
+                       .count();
+    counter++;
+  }
+  void addTime(long nanoseconds, long calls) {
+    runningTime += nanoseconds;
+    counter += calls;
+  }
+  void addBytes(long b) { bytes += b; }
+  void addEvents(long e) { events += e; }
+
+  long getTime() { return runningTime; }
+  double getTimeSec() { return runningTime / 1.0e9; }
+  long getCounter() { return counter; }
+  long getBytes() { return bytes; }
+  long getEvents() { return events; }
+};
+
+/**
+ * profiler keeps one benchmark per processing stage. The library
+ * stages are predefined, applications can register their own with
+ * addStage() and use the returned id in the same calls. A stage can
+ * be marked as part of another one (setParent), it is then shown
+ * under it and its time is not added to the total again.
+ */
+class profiler {
+ public:
+  enum stage_t {
+    STAGE_IO = 0,      // seek + read of compressed records
+    STAGE_DECOMPRESS,  // LZ4 (or memcpy) of the record payload
+    STAGE_INDEX,       // event index length to offset conversion
+    STAGE_SCAN,        // event copy and node scanning
+    STAGE_RECORD_INDEX,
+    STAGE_LIBRARY_MAX
+  };
+  static const int MAX_STAGES = 64;
+
+ private:
+  /**
+   * accumulators of one thread. Only the owning thread adds to them,
+   * they are relaxed atomics so show() can read them while the thread
+   * runs. The slot is added to the totals when its thread exits.
+   */
+  struct slot {
+    std::chrono::steady_clock::time_point clockStart[MAX_STAGES];
+    std::atomic<long> time[MAX_STAGES];
+    std::atomic<long> counter[MAX_STAGES];
+    std::atomic<long> bytes[MAX_STAGES];
+    std::atomic<long> events[MAX_STAGES];
+    slot();
+    ~slot();
+    void reset();
+    static void add(std::atomic<long> &value, long n) {
+      value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+  };
+  static slot &local() {
+    static thread_local slot threadSlot;
+    return threadSlot;
+  }
+
+  static std::atomic<bool> profileEnabled;
+
+ public:
+  static void enable(bool flag = true);
+  static bool isEnabled() { return profileEnabled.load(std::memory_order_relaxed); }
+
+  /** id of a new stage (or of the existing one with that name), -1 when there are MAX_STAGES */
+  static int addStage(const char *name);
+  /** stage is part of parent, e.g. the library stages of an application "read" stage */
+  static void setParent(int stage, int parent);
+  /** the numbers of a stage added up over all threads */
+  static benchmark getStage(int stage);
+
+  static void resume(int stage) {
+    if (isEnabled() && stage >= 0) local().clockStart[stage] = std::chrono::steady_clock::now();
+  }
+  static void pause(int stage) {
+    if (isEnabled() && stage >= 0) {
+      slot &s = local();
+      slot::add(s.time[stage], std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                   std::chrono::steady_clock::now() - s.clockStart[stage])
+                                   .count());
+      slot::add(s.counter[stage], 1);
+    }
+  }
+  static void pause(int stage, long bytes, long events = 0) {
+    if (isEnabled() && stage >= 0) {
+      pause(stage);
+      slot &s = local();
+      slot::add(s.bytes[stage], bytes);
+      slot::add(s.events[stage], events);
+    }
+  }
+
+  static void show(double wallTime);
+  static std::string getJson(double wallTime);
+};
+
+}  // namespace hipo
+
+#endif /* HIPO_PROFILER_H */
@@ -4,10 +4,23 @@
  */
 
 #include "hipoexceptions.h"
+#include "hiposwap.h"
+#include "profiler.h"
 #include "reader.h"
 #include "record.h"
 
+#include <errno.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
 #include <cstdlib>
+#include <cstring>
 /**
  * HIPO namespace is used for the classes that read write
  * files and records.
@@ -22,23 +35,52 @@ reader::reader() {
   printWarning();
   // hipoutils.printLogo();
   isRandomAccess = false;
+  dictionaryLoaded = false;
+  readAhead = 0;
+  fetcher = NULL;
+  streamInput = NULL;
+  followMode = false;
+  followNotify = -1;
+  maxEvents = -1;
+  summaryChecked = false;
+  currentRecord = &inRecordStream;
 }
 
 reader::reader(bool ra) {
   printWarning();
   // hipoutils.printLogo();
   isRandomAccess = ra;
+  dictionaryLoaded = false;
+  readAhead = 0;
+  fetcher = NULL;
+  streamInput = NULL;
+  followMode = false;
+  followNotify = -1;
+  maxEvents = -1;
+  summaryChecked = false;
+  currentRecord = &inRecordStream;
 }
 
 reader::reader(const char *infile) {
   printWarning();
   isRandomAccess = false;
+  dictionaryLoaded = false;
+  readAhead = 0;
+  fetcher = NULL;
+  streamInput = NULL;
+  followMode = false;
+  followNotify = -1;
+  maxEvents = -1;
+  summaryChecked = false;
+  currentRecord = &inRecordStream;
   this->open(infile);
 }
 /**
  * Default destructor. Does nothing
  */
 reader::~reader() {
+  if (fetcher != NULL) delete fetcher;
+  if (followNotify >= 0) ::close(followNotify);
   if (inputStream.is_open() == true) {
     inputStream.close();
   }
@@ -50,9 +92,16 @@ reader::~reader() {
  * file will be closed and warning message is printed.
  */
 void reader::open(const char *filename) {
+  if (strcmp(filename, "-") == 0) {
+    if (openStream(STDIN_FILENO) == false) exit(1);
+    return;
+  }
   if (inputStream.is_open() == true) {
     inputStream.close();
   }
+  streamInput = NULL;
+  streamOwned.reset();
+  streamBuffer.reset();
 
   inputStream.open(filename, std::ios::binary);
   inputStream.seekg(0, std::ios_base::end);
@@ -63,23 +112,59 @@ void reader::open(const char *filename) {
     exit(1);
   }
 
-  recordsProcessed = 0;
-  eventsProcessed = 0;
-
-  readHeader();
+  resetState();
+  inputFileName = filename;
+  readHeader(inputStream);
   bool status = verifyFile();
   if (status == false) {
     inputStream.close();
   }
 
+  if (fetcher != NULL) {
+    delete fetcher;
+    fetcher = NULL;
+  }
+  if (readAhead > 0) isRandomAccess = true;
+
+  if (followMode == true) {
+    // records are read as they become complete, the first one may not be there yet
+    isRandomAccess = false;
+    if (followNotify >= 0) ::close(followNotify);
+    followNotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (followNotify >= 0 && inotify_add_watch(followNotify, filename, IN_MODIFY | IN_CLOSE_WRITE) < 0) {
+      ::close(followNotify);
+      followNotify = -1;
+    }
+    sequence.setRecordEvents(0);
+    sequence.setCurrentEvent(0);
+    sequence.setNextPosition(header.firstRecordPosition);
+    return;
+  }
+
+  loadSummary();
   if (isRandomAccess == true) {
     readRecordIndex();
+    if (readAhead > 0) {
+      fetcher = new hipo::recordFetcher();
+      if (fetcher->open(filename, readAhead) == false) {
+        delete fetcher;
+        fetcher = NULL;
+      }
+    }
+    selectRecords();
+  } else if (skipsRecords() == true) {
+    // the first record may not have a selected event, next() reads it
+    sequence.setRecordEvents(0);
+    sequence.setCurrentEvent(0);
+    sequence.setNextPosition(header.firstRecordPosition);
   } else {
     //--------------------------------------------------------
     // This part is for sequancial access of the file
     //--------------------------------------------------------
     long positionOffset = header.firstRecordPosition;
+    inRecordStream.setEventLimit(recordEventLimit(0));
     inRecordStream.readRecord(inputStream, positionOffset, 0);
+    countRecord(positionOffset, inRecordStream);
     int length = inRecordStream.getRecordSizeCompressed() * 4;
     sequence.setRecordEvents(inRecordStream.getEventCount());
     sequence.setPosition(positionOffset);
@@ -95,6 +180,322 @@ void reader::open(const char *filename) {
   // readDictionary();
 }
 
+/**
+ * random access: marks the records left out by the sampling or the
+ * bank summary (fetchOrder -1) and gives the others to the read-ahead.
+ */
+void reader::selectRecords() {
+  fetchOrder.clear();
+  recordsSkipped = 0;
+  if (skipsRecords() == true) {
+    long firstEvent = 0;
+    for (int i = 0; i < recordIndex.size(); i++) {
+      long position = recordIndex[i].recordPosition;
+      bool selected = sampler.selectedEnd(position, firstEvent, recordIndex[i].recordEvents) > 0 &&
+                      summaryRejects(position) == false;
+      firstEvent += recordIndex[i].recordEvents;
+      if (selected == false && recordIndex[i].recordEvents > 0) recordsSkipped++;
+      fetchOrder.push_back(selected ? 0 : -1);
+    }
+  }
+  if (fetcher != NULL) {
+    std::vector<std::pair<long, long> > records;
+    for (int i = 0; i < recordIndex.size(); i++) {
+      if (fetchOrder.empty() == false) {
+        if (fetchOrder[i] < 0) continue;
+        fetchOrder[i] = records.size();
+      }
+      records.push_back(std::make_pair(recordIndex[i].recordPosition, recordIndex[i].recordLength * 4L));
+    }
+    fetcher->setRecords(records);
+  }
+}
+
+bool reader::requireBank(const char *bank, int minRows) {
+  if (isOpen() == false) {
+    printf("[READER] ** error ** bank %s can only be required after the file is opened\n", bank);
+    return false;
+  }
+  hipo::dictionary *dict = getSchemaDictionary();
+  if (dict->hasSchema(bank) == false) {
+    printf("[READER] ** error ** bank %s is not in the dictionary\n", bank);
+    return false;
+  }
+  return requireBank(dict->getSchema(bank).getGroup(), minRows);
+}
+
+bool reader::requireBank(int group, int minRows) {
+  requiredBanks.push_back(std::make_pair(group, std::max(minRows, 1)));
+  if (isOpen() == false) return true;
+  loadSummary();
+  // records not read yet are selected again, sequential reading checks each one when it gets there
+  if (isRandomAccess == true && recordIndex.empty() == false) selectRecords();
+  return true;
+}
+
+/**
+ * looks for the summary sidecar of the input file once there is a
+ * bank filter. It is not used on streams and followed files, which
+ * are still changing or can not be checked.
+ */
+void reader::loadSummary() {
+  if (summaryChecked == true || requiredBanks.empty() == true) return;
+  if (streamInput != NULL || followMode == true || inputFileName.empty() == true) return;
+  summaryChecked = true;
+  std::string name = fileSummary::sidecarName(inputFileName.c_str());
+  if (bankSummary.read(name.c_str(), inputFileName.c_str()) == true)
+    printf("[READER] records are selected with the bank summary %s\n", name.c_str());
+}
+
+/** true when the summary shows no event of the record at position passes the bank filter */
+bool reader::summaryRejects(long position) {
+  if (bankSummary.isEmpty() == true) return false;
+  int record = bankSummary.findRecord(position);
+  if (record < 0) return false;
+  for (int i = 0; i < requiredBanks.size(); i++)
+    if (bankSummary.mayHave(record, requiredBanks[i].first, requiredBanks[i].second) == false) return true;
+  return false;
+}
+
+bool reader::hasRequiredBanks() {
+  for (int i = 0; i < requiredBanks.size(); i++)
+    if (inEventStream.getRows(requiredBanks[i].first) < requiredBanks[i].second) return false;
+  return true;
+}
+
+void reader::resetState() {
+  recordsProcessed = 0;
+  eventsProcessed = 0;
+  fileDictionary.clear();
+  schemaDictionary = hipo::dictionary();
+  dictionaryLoaded = false;
+  inputPosition = 0;
+  bytesCompressed = 0;
+  bytesUncompressed = 0;
+  eventsRead = 0;
+  recordFirstEvent = 0;
+  sampledEvents = 0;
+  recordsSkipped = 0;
+  fetchOrder.clear();
+  bankSummary = hipo::fileSummary();
+  summaryChecked = false;
+  inputFileName.clear();
+  recordCache.clear();
+  currentRecord = &inRecordStream;
+}
+
+/**
+ * reads the input through a file descriptor, the buffer is refilled
+ * with read() so pipes and sockets work.
+ */
+class fdStreamBuffer : public std::streambuf {
+ private:
+  int fileDescriptor;
+  std::vector<char> buffer;
+
+ protected:
+  int_type underflow() {
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+    ssize_t n;
+    do {
+      n = ::read(fileDescriptor, &buffer[0], buffer.size());
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) return traits_type::eof();
+    setg(&buffer[0], &buffer[0], &buffer[0] + n);
+    return traits_type::to_int_type(*gptr());
+  }
+
+ public:
+  fdStreamBuffer(int fd) : fileDescriptor(fd), buffer(1024 * 1024) { setg(&buffer[0], &buffer[0], &buffer[0]); }
+};
+
+bool reader::openStream(int fd) {
+  streamBuffer.reset(new fdStreamBuffer(fd));
+  streamOwned.reset(new std::istream(streamBuffer.get()));
+  return openStream(*streamOwned);
+}
+
+/**
+ * Streaming mode: the file header and the user header (dictionary)
+ * are read first, then next() reads one record after the other. The
+ * input size is unknown, progress is reported in bytes only.
+ */
+bool reader::openStream(std::istream &stream) {
+  if (inputStream.is_open() == true) inputStream.close();
+  if (fetcher != NULL) {
+    delete fetcher;
+    fetcher = NULL;
+  }
+  if (readAhead > 0) printf("[READER] read-ahead is not used on streams\n");
+  if (&stream != streamOwned.get()) {
+    streamOwned.reset();
+    streamBuffer.reset();
+  }
+  streamInput = &stream;
+  isRandomAccess = false;
+  inputStreamSize = 0;
+  resetState();
+  recordIndex.clear();
+  inReaderIndex.reset();
+
+  readHeader(stream);
+  long skip = header.headerLength * 4L - 56;
+  if (stream.good() == false || skip < 0) {
+    printf("[READER] ** error ** the input stream does not start with a file header\n");
+    streamInput = NULL;
+    return false;
+  }
+  streamRecord.resize(skip);
+  userHeaderBuffer.resize(header.userHeaderLength > 0 ? header.userHeaderLength : 0);
+  if (readStream(streamRecord.data(), skip) == false ||
+      readStream(userHeaderBuffer.data(), userHeaderBuffer.size()) == false) {
+    printf("[READER] ** error ** the input stream ends in the file header\n");
+    streamInput = NULL;
+    return false;
+  }
+  streamPosition = header.firstRecordPosition;
+  inputPosition = streamPosition;
+
+  sequence.setRecordEvents(0);
+  sequence.setCurrentEvent(0);
+  sequence.setNextPosition(streamPosition);
+  return true;
+}
+
+bool reader::readStream(char *buffer, long length) {
+  if (length <= 0) return true;
+  streamInput->read(buffer, length);
+  return streamInput->gcount() == length;
+}
+
+/**
+ * reads the next record from the stream into inRecordStream, the
+ * record length is taken from its header. False at the end of the
+ * input or on an incomplete record.
+ */
+bool reader::readStreamRecord() {
+  while (true) {
+    fitBuffer(streamRecord, 56, 0);
+    streamInput->read(&streamRecord[0], 56);
+    if (streamInput->gcount() == 0) return false;
+    bool swapped = endian::load32<false>(&streamRecord[28]) == endian::SWAPPED_MAGIC;
+    long bytes = (swapped ? endian::load32<true>(&streamRecord[0]) : endian::load32<false>(&streamRecord[0])) * 4L;
+    int events = swapped ? endian::load32<true>(&streamRecord[12]) : endian::load32<false>(&streamRecord[12]);
+    if (streamInput->gcount() < 56 || bytes < 56) {
+      printf("[READER] ** error ** record at position %ld is incomplete\n", streamPosition);
+      return false;
+    }
+    fitBuffer(streamRecord, bytes, 0);
+    if (readStream(&streamRecord[56], bytes - 56) == false) {
+      printf("[READER] ** error ** record at position %ld is incomplete\n", streamPosition);
+      return false;
+    }
+    // a skipped record has to be read off the stream, but is not decompressed
+    int limit;
+    bool selected = sampleRecord(streamPosition, events, limit);
+    sequence.setPosition(streamPosition);
+    streamPosition += bytes;
+    if (selected == false) continue;
+    inRecordStream.setEventLimit(limit);
+    if (inRecordStream.readRecord(&streamRecord[0], bytes) == false) return false;
+    countRecord(streamPosition - bytes, inRecordStream);
+    recordsProcessed++;
+    return true;
+  }
+}
+
+void reader::setFollow(double idleSeconds, int pollMilliseconds) {
+  followMode = true;
+  followTimeout = idleSeconds;
+  followPoll = (pollMilliseconds > 0) ? pollMilliseconds : 250;
+  if (readAhead > 0) printf("[READER] read-ahead is not used when following a file\n");
+  readAhead = 0;
+}
+
+/**
+ * waits until the file is at least size bytes long, false when it did
+ * not grow for followTimeout seconds. Writes on network file systems
+ * do not always raise inotify events, so the size is also checked
+ * every followPoll milliseconds.
+ */
+bool reader::followWaitData(long size) {
+  bool waiting = false;
+  std::chrono::steady_clock::time_point idleStart = std::chrono::steady_clock::now();
+  while (inputStreamSize < size) {
+    struct stat info;
+    if (stat(inputFileName.c_str(), &info) == 0 && info.st_size > inputStreamSize) {
+      inputStreamSize = info.st_size;
+      idleStart = std::chrono::steady_clock::now();
+      continue;
+    }
+    if (waiting == false) {
+      waiting = true;
+      if (followWaitCallback) followWaitCallback();
+    }
+    std::chrono::duration<double> idle = std::chrono::steady_clock::now() - idleStart;
+    if (followTimeout > 0 && idle.count() >= followTimeout) return false;
+    if (followNotify >= 0) {
+      struct pollfd watch;
+      watch.fd = followNotify;
+      watch.events = POLLIN;
+      if (poll(&watch, 1, followPoll) > 0) {
+        char events[4096];
+        while (read(followNotify, events, sizeof(events)) > 0) {
+        }
+      }
+    } else {
+      usleep(followPoll * 1000);
+    }
+  }
+  return true;
+}
+
+/**
+ * follow mode: reads the next record with events, waiting for the
+ * writer when the record is not complete in the file yet. Reading
+ * resumes at the end of the last complete record.
+ */
+bool reader::followNextRecord() {
+  long position = sequence.getNextPosition();
+  while (true) {
+    if (followWaitData(position + 56) == false) return false;
+    int events;
+    long length;
+    if (readRecordHead(position, events, length) == false) return false;
+    if (followWaitData(position + length) == false) return false;
+    inputStream.clear();
+    int limit;
+    if (sampleRecord(position, events, limit) == false) {
+      position += length;
+      sequence.setNextPosition(position);
+      continue;
+    }
+    inRecordStream.setEventLimit(limit);
+    if (inRecordStream.readRecord(inputStream, position, 0, inputStreamSize) == false) return false;
+    recordsProcessed++;
+    countRecord(position, inRecordStream);
+    sequence.setPosition(position);
+    position += inRecordStream.getRecordSizeCompressed() * 4L;
+    sequence.setNextPosition(position);
+    if (inRecordStream.getEventCount() > 0) break;
+  }
+  sequence.setRecordEvents(inRecordStream.getEventCount());
+  sequence.setCurrentEvent(0);
+  return true;
+}
+
+/**
+ * Updates the progress counters after a record was read. The position
+ * is advanced to the end of the record, so position/size gives the
+ * fraction of the file consumed without scanning the record index.
+ */
+void reader::countRecord(long position, hipo::record &record) {
+  long length = record.getRecordSizeCompressed() * 4L;
+  inputPosition.store(position + length, std::memory_order_relaxed);
+  bytesCompressed.fetch_add(length, std::memory_order_relaxed);
+  bytesUncompressed.fetch_add(record.getRecordSizeUncompressed(), std::memory_order_relaxed);
+}
+
 hipo::generic_node *reader::getGenericBranch(int group, int item) {
   return inEventStream.getEventGenericBranch(group, item);
 }
@@ -102,9 +503,10 @@ hipo::generic_node *reader::getGenericBranch(int group, int item) {
  * Reads the file header. The endiannes is determined for bytes
  * swap. The header structure will be filled with file parameters.
  */
-void reader::readHeader() {
+void reader::readHeader(std::istream &stream) {
+  // only the 56 bytes of the header proper, a stream continues with the user header
   headerBuffer.resize(80);
-  inputStream.read(&headerBuffer[0], 80);
+  stream.read(&headerBuffer[0], 56);
   header.uniqueid = *(reinterpret_cast<int *>(&headerBuffer[0]));
   header.filenumber = *(reinterpret_cast<int *>(&headerBuffer[4]));
   header.headerLength = *(reinterpret_cast<int *>(&headerBuffer[8]));
@@ -146,9 +548,11 @@ bool reader::verifyFile() { return true; }
 /**
  * Checks to determine if the file is open.
  */
-bool reader::isOpen() { return inputStream.is_open(); }
+bool reader::isOpen() { return inputStream.is_open() || streamInput != NULL; }
 
 void reader::readDictionary() {
+  dictionaryLoaded = true;
+  if (header.userHeaderLength <= 0) return;
   hipo::record dictionary;
   hipo::event schema;
   readHeaderRecord(dictionary);
@@ -161,33 +565,73 @@ void reader::readDictionary() {
   }
 }
 
-std::vector<std::string> reader::getDictionary() { return fileDictionary; }
+std::vector<std::string> reader::getDictionary() {
+  if (dictionaryLoaded == false) readDictionary();
+  return fileDictionary;
+}
 
 int reader::numEvents() {
   readRecordIndex();
   return inReaderIndex.getMaxEvents();
 }
 
+/**
+ * number of events to decode in a record whose first needed event is
+ * first, -1 (all) when no event limit is set.
+ */
+int reader::recordEventLimit(int first) {
+  if (maxEvents < 0) return -1;
+  long remaining = maxEvents - getEventsRead();
+  if (remaining < 1) remaining = 1;  // gotoEvent() past the limit
+  return (remaining < INT_MAX - first) ? first + remaining : -1;
+}
+
 bool reader::next() {
+  while (readNext() == true) {
+    if (hasRequiredBanks() == true) return true;
+  }
+  return false;
+}
+
+bool reader::readNext() {
   // printf("random access = %d\n",isRandomAccess);
+  if (maxEvents >= 0 && getEventsRead() >= maxEvents) return false;
   if (isRandomAccess == true) {
-    if (inReaderCurrentRecord < 0) {
-      inReaderCurrentRecord = 0;
-      readRecord(inRecordStream, inReaderCurrentRecord);
-      inRecordStream.readHipoEvent(inEventStream, 0);
-      return true;
+    if (recordIndex.empty() == true) return false;
+    bool first = (inReaderCurrentRecord < 0);
+    if (first == false && inReaderIndex.advance() == false) return false;
+    while (skipsRecords() == true) {
+      int index = inReaderIndex.getRecordNumber();
+      long firstEvent = inReaderIndex.getEventNumber() - inReaderIndex.getRecordEventNumber();
+      if (fetchOrder[index] >= 0 &&
+          sampler.keep(recordIndex[index].recordPosition, firstEvent, inReaderIndex.getRecordEventNumber()) == true)
+        break;
+      if (inReaderIndex.advance() == false) return false;
     }
-
-    bool status = inReaderIndex.advance();
-    if (status == false) return false;
-    if (inReaderIndex.getRecordNumber() != inReaderCurrentRecord) {
+    if (first == true || inReaderIndex.getRecordNumber() != inReaderCurrentRecord) {
       inReaderCurrentRecord = inReaderIndex.getRecordNumber();
-      readRecord(inRecordStream, inReaderCurrentRecord);
+      currentRecord = cachedRecord(inReaderCurrentRecord, indexEventLimit());
+      if (currentRecord == NULL) return false;
     }
-    inRecordStream.readHipoEvent(inEventStream, inReaderIndex.getRecordEventNumber());
-  } else {
+    currentRecord->readHipoEvent(inEventStream, inReaderIndex.getRecordEventNumber());
+    eventsRead.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  while (true) {
     // int current_event = sequence.getCurrentEvent();
     // printf("next() : current event %d has event %d\n",current_event,sequence.hasEvents());
+    if (sequence.hasEvents() == false && streamInput != NULL) {
+      // records without events (e.g. the trailer) are skipped
+      do {
+        if (readStreamRecord() == false) return false;
+      } while (inRecordStream.getEventCount() == 0);
+      sequence.setRecordEvents(inRecordStream.getEventCount());
+      sequence.setCurrentEvent(0);
+    }
+    if (sequence.hasEvents() == false && followMode == true) {
+      if (followNextRecord() == false) return false;
+    }
     if (sequence.hasEvents() == false) {
       // printf(" READING NEXT BANCH \n");
       if (sequence.getNextPosition() < 0) {
@@ -196,11 +640,27 @@ bool reader::next() {
       long positionOffset = sequence.getNextPosition();
       // inRecordStream.readRecord(inputStream,positionOffset,0);
 
+      int limit = recordEventLimit(0);
+      if (skipsRecords() == true) {
+        // only the headers of records without a selected event are read
+        int events;
+        long length;
+        while (true) {
+          if (positionOffset >= inputStreamSize - 56 || readRecordHead(positionOffset, events, length) == false) {
+            sequence.setNextPosition(-1);
+            return false;
+          }
+          if (sampleRecord(positionOffset, events, limit) == true) break;
+          positionOffset += length;
+        }
+      }
+      inRecordStream.setEventLimit(limit);
       bool status = inRecordStream.readRecord(inputStream, positionOffset, 0, inputStreamSize);
       recordsProcessed++;
       if (status == false) {
         return false;
       }
+      countRecord(positionOffset, inRecordStream);
       int length = inRecordStream.getRecordSizeCompressed() * 4;
       // printf(" READING DONE %d %d \n",length,inRecordStream.getEventCount());
       sequence.setRecordEvents(inRecordStream.getEventCount());
@@ -214,15 +674,71 @@ bool reader::next() {
       }
     }
     int current_event = sequence.getCurrentEvent();
+    sequence.setCurrentEvent(current_event + 1);
+    if (sampler.isEnabled() == true && sampler.keep(sequence.getPosition(), recordFirstEvent, current_event) == false)
+      continue;
     // printf("1\n");
     inRecordStream.readHipoEvent(inEventStream, current_event);
     eventsProcessed++;
+    eventsRead.fetch_add(1, std::memory_order_relaxed);
     // printf("2\n");
-    sequence.setCurrentEvent(current_event + 1);
     return true;
   }
-  return true;
 }
+
+/**
+ * reads the length (in bytes) and the number of events from the header
+ * of the record at position, false if the header can not be read.
+ */
+bool reader::readRecordHead(long position, int &events, long &length) {
+  char head[32];
+  inputStream.clear();
+  inputStream.seekg(position, std::ios::beg);
+  inputStream.read(head, 32);
+  if (inputStream.gcount() < 32) return false;
+  if (endian::load32<false>(head + 28) == endian::SWAPPED_MAGIC) {
+    length = endian::load32<true>(head) * 4L;
+    events = endian::load32<true>(head + 12);
+  } else {
+    length = endian::load32<false>(head) * 4L;
+    events = endian::load32<false>(head + 12);
+  }
+  return length >= 56;
+}
+
+/**
+ * prescale, sampling and bank summary in sequential reading (file,
+ * stream, follow): sets the event limit for the record at position and
+ * returns false when none of its events is selected, the record is
+ * then skipped.
+ */
+bool reader::sampleRecord(long position, int events, int &limit) {
+  limit = recordEventLimit(0);
+  if (skipsRecords() == false) return true;
+  bool selected = true;
+  if (sampler.isEnabled() == true) {
+    limit = sampler.selectedEnd(position, sampledEvents, events);
+    selected = (limit > 0);
+  }
+  if (selected == true && summaryRejects(position) == true) selected = false;
+  recordFirstEvent = sampledEvents;
+  sampledEvents += events;
+  if (selected == false && events > 0) recordsSkipped++;
+  return selected;
+}
+
+/**
+ * event limit of the record at the current position of the index
+ * (random access): the last selected event when sampling, otherwise
+ * the one given by the max events.
+ */
+int reader::indexEventLimit() {
+  if (sampler.isEnabled() == false) return recordEventLimit(inReaderIndex.getRecordEventNumber());
+  int index = inReaderIndex.getRecordNumber();
+  long firstEvent = inReaderIndex.getEventNumber() - inReaderIndex.getRecordEventNumber();
+  return sampler.selectedEnd(recordIndex[index].recordPosition, firstEvent, recordIndex[index].recordEvents);
+}
+
 /**
  * Reads records indicies, it hopes through file Reading
  * only header for each records and fills a vector with
@@ -232,6 +748,11 @@ bool reader::next() {
  * record information.
  */
 void reader::readRecordIndex() {
+  if (streamInput != NULL) {
+    printf("[READER] ** error ** the record index is not available on a stream\n");
+    return;
+  }
+  profiler::resume(profiler::STAGE_RECORD_INDEX);
   inputStream.seekg(0, std::ios::end);
   long hipoFileSize = inputStream.tellg();
   long positionOffset = header.firstRecordPosition;
@@ -254,15 +775,14 @@ void reader::readRecordIndex() {
     int version = *(reinterpret_cast<int *>(&recheader[20]));
     int magic_number = *(reinterpret_cast<int *>(&recheader[28]));
 
-    recIndex.recordDataLengthCompressed = compressWord & 0x0FFFFFFF;
-    // recIndex.compressionType            = (compressWord&0xF0000000)>>28;
-
     if (magic_number == 0x0001dac0) {
       recIndex.recordLength = __builtin_bswap32(recIndex.recordLength);
       recIndex.recordEvents = __builtin_bswap32(recIndex.recordEvents);
       compressWord = __builtin_bswap32(compressWord);
       version = __builtin_bswap32(version);
     }
+    recIndex.recordDataLengthCompressed = compressWord & 0x0FFFFFFF;
+    // recIndex.compressionType            = (compressWord&0xF0000000)>>28;
 
     inReaderIndex.addSize(recIndex.recordEvents);
 
@@ -281,22 +801,87 @@ void reader::readRecordIndex() {
     recordIndex.push_back(recIndex);
     icounter++;
   }
+  profiler::pause(profiler::STAGE_RECORD_INDEX, 56L * icounter, inReaderIndex.getMaxEvents());
 #ifdef __DEBUG__
   std::cout << "total records = "<<icounter<<" index array = " << (unsigned int)recordIndex.size()) << std::endl;
 #endif
 }
 
-hipo::dictionary *reader::getSchemaDictionary() { return &schemaDictionary; }
+hipo::dictionary *reader::getSchemaDictionary() {
+  if (dictionaryLoaded == false) readDictionary();
+  return &schemaDictionary;
+}
 
 void reader::readHeaderRecord(hipo::record &record) {
+  if (streamInput != NULL) {
+    record.readRecord(userHeaderBuffer.data(), userHeaderBuffer.size());
+    return;
+  }
   int offset = header.headerLength * 4;
   int rlenght = header.userHeaderLength;
   record.readRecord(inputStream, offset, 0);
 }
 
 void reader::readRecord(hipo::record &record, int index) {
+  if (recordCache.isEnabled() == false) {
+    loadRecord(record, index);
+    return;
+  }
+  hipo::record *cached = cachedRecord(index);
+  if (cached != NULL) record = *cached;
+}
+
+/**
+ * returns the decompressed record, from the cache when it is enabled,
+ * NULL if the record could not be read. Without the cache the record
+ * is read into inRecordStream, decoding up to eventLimit events.
+ */
+hipo::record *reader::cachedRecord(int index, int eventLimit) {
+  if (recordCache.isEnabled() == false) {
+    if (loadRecord(inRecordStream, index, eventLimit) == false) return NULL;
+    countRecord(recordIndex[index].recordPosition, inRecordStream);
+    return &inRecordStream;
+  }
+  hipo::record *record = recordCache.find(index);
+  if (record == NULL) {
+    record = recordCache.take();
+    if (loadRecord(*record, index) == false) {
+      delete record;
+      return NULL;
+    }
+    countRecord(recordIndex[index].recordPosition, *record);
+    recordCache.put(index, record);
+  }
+  if (index == inReaderCurrentRecord) recordCache.pin(index);
+  return record;
+}
+
+bool reader::gotoEvent(int event) {
+  if (isRandomAccess == false || inReaderIndex.gotoEvent(event) == false) return false;
+  inReaderCurrentRecord = inReaderIndex.getRecordNumber();
+  // the event asked for may not be one selected by the sampling
+  int limit = sampler.isEnabled() ? -1 : recordEventLimit(inReaderIndex.getRecordEventNumber());
+  currentRecord = cachedRecord(inReaderCurrentRecord, limit);
+  if (currentRecord == NULL) return false;
+  currentRecord->readHipoEvent(inEventStream, inReaderIndex.getRecordEventNumber());
+  eventsRead.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool reader::loadRecord(hipo::record &record, int index, int eventLimit) {
+  record.setEventLimit(eventLimit);
+  int order = fetchOrder.empty() ? index : fetchOrder[index];
+  if (fetcher != NULL && order >= 0) {
+    // records skipped by the sampling are not in the read-ahead list
+    if (fetcher->getNextRecord() != order) fetcher->seek(order);
+    profiler::resume(profiler::STAGE_IO);
+    bool status = fetcher->next(fetchBuffer);
+    profiler::pause(profiler::STAGE_IO, fetchBuffer.size());
+    if (status == false) return false;
+    return record.readRecord(&fetchBuffer[0], fetchBuffer.size());
+  }
   long position = recordIndex[index].recordPosition;
-  record.readRecord(inputStream, position, 0);
+  return record.readRecord(inputStream, position, 0, inputStreamSize);
 }
 void reader::readRecord(int index) {
   hipo::record rec;
@@ -349,7 +934,7 @@ void reader::printWarning() {
 }  // namespace hipo
 
 //*************************************************************************
-// implementation of record_index class
+// implementation of record_index and reader_cache classes
 //*************************************************************************
 namespace hipo {
 
@@ -363,6 +948,40 @@ void reader_index::addSize(int size) {
   }
 }
 
+uint64_t reader_sampler::mix(uint64_t key) {
+  // splitmix64 finalizer
+  key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+  return key ^ (key >> 31);
+}
+
+void reader_sampler::setFraction(double fraction, uint64_t s) {
+  seed = s;
+  if (fraction >= 1.0) {
+    recordFraction = eventFraction = 1.0;
+    return;
+  }
+  if (fraction < 0.0) fraction = 0.0;
+  recordFraction = std::sqrt(fraction);
+  eventFraction = recordFraction;
+}
+
+bool reader_sampler::keep(long position, long firstEvent, int event) {
+  if (prescale > 1 && (firstEvent + event) % prescale != 0) return false;
+  uint64_t record = mix(seed ^ mix((uint64_t)position));
+  if (recordFraction < 1.0 && uniform(record) >= recordFraction) return false;
+  if (eventFraction < 1.0 && uniform(record + event + 1) >= eventFraction) return false;
+  return true;
+}
+
+int reader_sampler::selectedEnd(long position, long firstEvent, int count) {
+  if (isEnabled() == false) return count;
+  if (recordFraction < 1.0 && uniform(mix(seed ^ mix((uint64_t)position))) >= recordFraction) return 0;
+  for (int event = count - 1; event >= 0; event--)
+    if (keep(position, firstEvent, event) == true) return event + 1;
+  return 0;
+}
+
 bool reader_index::advance() {
   if (recordEvents.size() == 0) return false;
 
@@ -382,8 +1001,67 @@ bool reader_index::advance() {
   return true;
 }
 
+bool reader_index::gotoEvent(int event) {
+  if (event < 0 || event >= getMaxEvents()) return false;
+  // recordEvents holds the first event of every record, the last entry is the total
+  std::vector<int>::iterator it = std::upper_bound(recordEvents.begin(), recordEvents.end(), event);
+  currentRecord = (it - recordEvents.begin()) - 1;
+  currentEvent = event;
+  currentRecordEvent = event - recordEvents[currentRecord];
+  return true;
+}
+
 int reader_index::getMaxEvents() {
   if (recordEvents.size() == 0) return 0;
   return recordEvents[recordEvents.size() - 1];
 }
+
+void reader_cache::clear() {
+  for (std::list<entry>::iterator it = entries.begin(); it != entries.end(); ++it) delete it->record;
+  entries.clear();
+  lookup.clear();
+  currentSize = 0;
+  pinned = -1;
+}
+
+hipo::record *reader_cache::find(int index) {
+  std::unordered_map<int, std::list<entry>::iterator>::iterator it = lookup.find(index);
+  if (it == lookup.end()) {
+    misses++;
+    return NULL;
+  }
+  hits++;
+  entries.splice(entries.begin(), entries, it->second);
+  return it->second->record;
+}
+
+hipo::record *reader_cache::take() {
+  if (currentSize < maxSize || entries.empty() || entries.back().index == pinned) return new hipo::record();
+  entry last = entries.back();
+  entries.pop_back();
+  lookup.erase(last.index);
+  currentSize -= last.size;
+  return last.record;
+}
+
+void reader_cache::put(int index, hipo::record *record) {
+  entry e;
+  e.index = index;
+  e.record = record;
+  e.size = record->getMemorySize();
+  entries.push_front(e);
+  lookup[index] = entries.begin();
+  currentSize += e.size;
+  // the new record and the pinned one stay, whatever their size
+  std::list<entry>::iterator it = entries.end();
+  while (currentSize > maxSize && it != entries.begin()) {
+    --it;
+    if (it == entries.begin()) break;
+    if (it->index == pinned) continue;
+    currentSize -= it->size;
+    lookup.erase(it->index);
+    delete it->record;
+    it = entries.erase(it);
+  }
+}
 }  // namespace hipo
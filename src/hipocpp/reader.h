@@ -77,15 +77,22 @@
 #define LITTLE_ENDIAN 1
 #endif
 
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <atomic>
 #include <climits>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <list>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 #include "dictionary.h"
+#include "fetcher.h"
 #include "record.h"
+#include "summary.h"
 #include "utils.h"
 
 namespace hipo {
@@ -143,6 +150,8 @@ class reader_index {
   int getRecordEventNumber() { return currentRecordEvent; }
   int getMaxEvents();
   void addSize(int size);
+  /** moves to the given event number, false if it is out of range */
+  bool gotoEvent(int event);
 
   void reset() {
     currentRecord = 0;
@@ -180,11 +189,92 @@ class reader_sequence {
   int getCurrentEvent() { return currentEvent; }
 };
 
+/**
+ * event selection for prescaled and sampled reading. A decision depends
+ * only on the record position in the file, the event number and the
+ * seed, so all read modes (sequential, random access, stream) select
+ * the same events, and a record without a selected event is skipped
+ * before its data is read.
+ */
+class reader_sampler {
+ private:
+  int prescale;           // every prescale-th event of the file (1 = all)
+  double recordFraction;  // probability to read a record
+  double eventFraction;   // probability to keep an event of a record that is read
+  uint64_t seed;
+
+  static uint64_t mix(uint64_t key);
+  static double uniform(uint64_t key) { return (mix(key) >> 11) * (1.0 / 9007199254740992.0); }
+
+ public:
+  reader_sampler() {
+    prescale = 1;
+    recordFraction = 1.0;
+    eventFraction = 1.0;
+    seed = 0;
+  }
+
+  void setPrescale(int n) { prescale = (n > 1) ? n : 1; }
+  void setFraction(double fraction, uint64_t s);
+  bool isEnabled() { return prescale > 1 || recordFraction < 1.0 || eventFraction < 1.0; }
+  /** event number event (in the record) of the record at position, its first event is firstEvent in the file */
+  bool keep(long position, long firstEvent, int event);
+  /** one past the last selected event of a record, 0 when nothing is selected */
+  int selectedEnd(long position, long firstEvent, int count);
+};
+
+/**
+ * LRU cache of decompressed records for random access, keyed by
+ * record index and bounded by the memory of the record buffers.
+ * The pinned record (the one events are read from) is never evicted.
+ */
+class reader_cache {
+ private:
+  struct entry {
+    int index;
+    hipo::record *record;
+    long size;
+  };
+  std::list<entry> entries;  // most recently used first
+  std::unordered_map<int, std::list<entry>::iterator> lookup;
+  long maxSize;
+  long currentSize;
+  long hits;
+  long misses;
+  int pinned;
+
+ public:
+  reader_cache() {
+    maxSize = 0;
+    currentSize = 0;
+    hits = 0;
+    misses = 0;
+    pinned = -1;
+  }
+  ~reader_cache() { clear(); }
+
+  void setSize(long bytes) { maxSize = bytes; }
+  bool isEnabled() { return maxSize > 0; }
+  void clear();
+
+  /** the cached record or NULL, counts the hit or miss */
+  hipo::record *find(int index);
+  /** a record to load a new index into, the least recently used one when the cache is full */
+  hipo::record *take();
+  void put(int index, hipo::record *record);
+  void pin(int index) { pinned = index; }
+
+  long getHits() { return hits; }
+  long getMisses() { return misses; }
+  long getBytes() { return currentSize; }
+};
+
 class reader {
  private:
   std::vector<std::string> fileDictionary;
 
   hipo::dictionary schemaDictionary;
+  bool dictionaryLoaded;  // the header record is parsed on first use
 
   std::vector<char> headerBuffer;
   std::ifstream inputStream;
@@ -206,11 +296,91 @@ class reader {
 
   long recordsProcessed;
   long eventsProcessed;
+  /**
+   * Progress counters, these are updated by the reading thread
+   * and can be polled from other threads (progress reporting).
+   */
+  std::atomic<long> inputPosition;
+  std::atomic<long> bytesCompressed;
+  std::atomic<long> bytesUncompressed;
+  std::atomic<long> eventsRead;
+
+  void countRecord(long position, hipo::record &record);
+
+  /**
+   * read-ahead of records, when enabled the records are read by the
+   * fetcher (several in flight) instead of the input stream.
+   */
+  int readAhead;
+  hipo::recordFetcher *fetcher;
+  hipo::byteBuffer fetchBuffer;
+  bool loadRecord(hipo::record &record, int index, int eventLimit = -1);
+
+  /** decompressed records kept for random access, see setRecordCache() */
+  hipo::reader_cache recordCache;
+  hipo::record *currentRecord;
+  hipo::record *cachedRecord(int index, int eventLimit = -1);
 
   bool isRandomAccess;
 
+  /** next() stops after maxEvents (-1 no limit), see setMaxEvents() */
+  long maxEvents;
+  int recordEventLimit(int first);
+
+  /** prescale and sampling, see setPrescale() and setFraction() */
+  hipo::reader_sampler sampler;
+  long recordFirstEvent;   // number in the file of the first event of the current record
+  long sampledEvents;      // events in the records before the next one (sequential reading)
+  long recordsSkipped;
+  std::vector<int> fetchOrder;  // position of each record in the read-ahead list, -1 when skipped
+  bool readRecordHead(long position, int &events, long &length);
+  bool sampleRecord(long position, int events, int &limit);
+  int indexEventLimit();
+
+  /**
+   * bank filter, see requireBank(): (group, minimum rows) that every
+   * event returned by next() has. Records the summary sidecar proves
+   * can not pass are skipped like the ones left out by the sampling.
+   */
+  std::vector<std::pair<int, int> > requiredBanks;
+  hipo::fileSummary bankSummary;
+  bool summaryChecked;  // the sidecar was looked for
+  bool skipsRecords() { return sampler.isEnabled() || bankSummary.isEmpty() == false; }
+  void loadSummary();
+  bool summaryRejects(long position);
+  bool hasRequiredBanks();
+  void selectRecords();
+  bool readNext();
+
+  /**
+   * forward-only input (pipes, stdin). Only the file header, the user
+   * header and one record at a time are held in memory.
+   */
+  std::istream *streamInput;
+  std::unique_ptr<std::streambuf> streamBuffer;
+  std::unique_ptr<std::istream> streamOwned;
+  hipo::byteBuffer streamRecord;
+  hipo::byteBuffer userHeaderBuffer;
+  long streamPosition;
+  bool readStream(char *buffer, long length);
+  bool readStreamRecord();
+
+  /**
+   * follow mode, the file is still being written: at its end the reader
+   * waits for new records instead of stopping (see setFollow()).
+   */
+  bool followMode;
+  double followTimeout;
+  int followPoll;
+  int followNotify;  // inotify descriptor, -1 when polling only
+  std::string inputFileName;
+  std::function<void()> followWaitCallback;
+  bool followNextRecord();
+  bool followWaitData(long size);
+
+  void resetState();
   bool verifyFile();
-  void readHeader();
+  void readHeader(std::istream &stream);
   void readRecordIndex();
   void readDictionary();
 
@@ -224,15 +394,87 @@ class reader {
 
   hipo::dictionary *getSchemaDictionary();
 
+  /** opens a file, "-" reads the standard input as a stream */
   void open(const char *filename);
+  /**
+   * reads the file strictly forward from a stream or a file descriptor
+   * (pipe, socket), nothing is seeked. Only next() is available, the
+   * record index, random access and read-ahead need open().
+   */
+  bool openStream(std::istream &stream);
+  bool openStream(int fd);
+  bool isStreaming() { return streamInput != NULL; }
+  /**
+   * follows a file that is still being written, must be called before
+   * open(). At the end of the file next() waits for the next complete
+   * record (inotify, or checking the size every pollMilliseconds) and
+   * returns false only after no data arrived for idleSeconds (0 waits
+   * forever). Reading is sequential, read-ahead is not used.
+   */
+  void setFollow(double idleSeconds, int pollMilliseconds = 250);
+  /** called every time the reader caught up with the file and starts waiting */
+  void setFollowWait(std::function<void()> callback) { followWaitCallback = callback; }
+  /**
+   * keeps up to depth records in flight (io_uring or reader threads),
+   * must be called before open(). The file is then read through the
+   * record index, as in random access mode.
+   */
+  void setReadAhead(int depth) { readAhead = depth; }
+  const char *getReadAheadBackend() { return (fetcher == NULL) ? "none" : fetcher->getBackend(); }
+  /**
+   * keeps up to megabytes of decompressed records in random access
+   * mode, so going back to a record does not read and decompress it
+   * again (0 disables the cache).
+   */
+  void setRecordCache(int megabytes) { recordCache.setSize(megabytes * 1024L * 1024L); }
+  long getCacheHits() { return recordCache.getHits(); }
+  long getCacheMisses() { return recordCache.getMisses(); }
+  /**
+   * next() returns false after n events (-1 reads everything). Records
+   * are then decompressed only up to the last event still needed, so
+   * reading the first events of a large file is quick.
+   */
+  void setMaxEvents(long n) { maxEvents = n; }
+  /**
+   * next() returns every n-th event of the file. Records holding none
+   * of them are skipped without reading their data. Set before open().
+   */
+  void setPrescale(int n) { sampler.setPrescale(n); }
+  /**
+   * next() returns a random fraction of the events, reproducible for a
+   * given seed. The sampling is done in two stages of equal strength:
+   * records are read with probability sqrt(fraction), so most records
+   * are never read, and events of the records read are kept with the
+   * same probability. Set before open().
+   */
+  void setFraction(double fraction, unsigned long seed = 0) { sampler.setFraction(fraction, seed); }
+  /**
+   * next() only returns events with at least minRows rows of the bank
+   * (all the banks, when called more than once). When the file has a
+   * summary sidecar (<file>.summary, see summary.h) the records none
+   * of whose events can pass are skipped without being read. The name
+   * is looked up in the dictionary, false when it is not there.
+   */
+  bool requireBank(const char *bank, int minRows = 1);
+  bool requireBank(int group, int minRows = 1);
+  /** records skipped by the prescale, the sampling or the bank summary without being read */
+  long getRecordsSkipped() { return recordsSkipped; }
+  /** random access: reads the event with the given number, next() continues after it */
+  bool gotoEvent(int event);
   void readRecord(int index);
   void readRecord(hipo::record &record, int index);
   void readHeaderRecord(hipo::record &record);
   int getRecordCount();
+  long getRecordPosition(int index) { return recordIndex[index].recordPosition; }
   bool isOpen();
   void showInfo();
   void printWarning();
   int numEvents();
+  long getInputSize() { return inputStreamSize; }
+  long getPosition() { return inputPosition.load(std::memory_order_relaxed); }
+  long getBytesCompressed() { return bytesCompressed.load(std::memory_order_relaxed); }
+  long getBytesUncompressed() { return bytesUncompressed.load(std::memory_order_relaxed); }
+  long getEventsRead() { return eventsRead.load(std::memory_order_relaxed); }
   bool next();
   hipo::event *getEvent() { return &inEventStream; }
   template <class T>
@@ -258,14 +500,9 @@ hipo::node<T> *reader::getBranch(int group, int item) {
 
 template <class T>
 hipo::node<T> *reader::getBranch(const char *group, const char *item) {
-  if (schemaDictionary.hasSchema(group) == true) {
-    hipo::schema schema = schemaDictionary.getSchema(group);
-    if (schema.hasEntry(item) == true) {
-      int group_id = schema.getGroup();
-      int item__id = schema.getItem(item);
-      return inEventStream.getBranch<T>(group_id, item__id);
-    }
-  }
+  const hipo::schema &schema = getSchemaDictionary()->getSchema(group);
+  int order = schema.getEntryOrder(item);
+  if (order >= 0) return inEventStream.getBranch<T>(schema.getGroup(), schema.getEntryItem(order));
   return NULL;
 }
 }  // namespace hipo
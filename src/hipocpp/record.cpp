@@ -5,310 +5,170 @@
  */
 
 #include "record.h"
-//#include "hipoexceptions.h"
+#include "codec.h"
+#include "hiposwap.h"
+#include "profiler.h"
 
-#ifdef __LZ4__
-#include "lz4.h"
-#endif
+#include <climits>
+//#include "hipoexceptions.h"
 
 namespace hipo {
 
-record::record() {}
+record::record() { eventLimit = -1; }
 
 record::~record() {}
 
 /**
+ * fills the record header from the 56 header bytes, the words are
+ * swapped when the record was written on a big endian machine.
  */
-void record::readRecord(std::ifstream &stream, long position, int dataOffset) {
-  recordHeaderBuffer.resize(80);
-  stream.seekg(position, std::ios::beg);
-
-  stream.read((char *)&recordHeaderBuffer[0], 80);
-  recordHeader.recordLength = *(reinterpret_cast<int *>(&recordHeaderBuffer[0]));
-  recordHeader.headerLength = *(reinterpret_cast<int *>(&recordHeaderBuffer[8]));
-  recordHeader.numberOfEvents = *(reinterpret_cast<int *>(&recordHeaderBuffer[12]));
-  recordHeader.bitInfo = *(reinterpret_cast<int *>(&recordHeaderBuffer[20]));
-  recordHeader.signatureString = *(reinterpret_cast<int *>(&recordHeaderBuffer[28]));
-  recordHeader.recordDataLength = *(reinterpret_cast<int *>(&recordHeaderBuffer[32]));
-  recordHeader.userHeaderLength = *(reinterpret_cast<int *>(&recordHeaderBuffer[24]));
-  int compressedWord = *(reinterpret_cast<int *>(&recordHeaderBuffer[36]));
-
-  if (recordHeader.signatureString == 0xc0da0100) recordHeader.dataEndianness = 0;
-  if (recordHeader.signatureString == 0x0001dac0) recordHeader.dataEndianness = 1;
-
-  if (recordHeader.signatureString == 0x0001dac0) {
-    recordHeader.recordLength = __builtin_bswap32(recordHeader.recordLength);
-    recordHeader.headerLength = __builtin_bswap32(recordHeader.headerLength);
-    recordHeader.numberOfEvents = __builtin_bswap32(recordHeader.numberOfEvents);
-    recordHeader.recordDataLength = __builtin_bswap32(recordHeader.recordDataLength);
-    recordHeader.userHeaderLength = __builtin_bswap32(recordHeader.userHeaderLength);
-    recordHeader.bitInfo = __builtin_bswap32(recordHeader.bitInfo);
-    compressedWord = __builtin_bswap32(compressedWord);
-  }
-
-  int compressedDataLengthPadding = (recordHeader.bitInfo >> 24) & 0x00000003;
-  int headerLengthBytes = recordHeader.headerLength * 4;
-  int dataBufferLengthBytes = recordHeader.recordLength * 4 - headerLengthBytes;
-
+template <bool swapped>
+void record::parseHeader(const char *buffer) {
+  recordHeader.recordLength = endian::load32<swapped>(buffer);
+  recordHeader.headerLength = endian::load32<swapped>(buffer + 8);
+  recordHeader.numberOfEvents = endian::load32<swapped>(buffer + 12);
+  recordHeader.bitInfo = endian::load32<swapped>(buffer + 20);
+  recordHeader.userHeaderLength = endian::load32<swapped>(buffer + 24);
+  recordHeader.signatureString = endian::load32<false>(buffer + 28);
+  recordHeader.recordDataLength = endian::load32<swapped>(buffer + 32);
+  int compressedWord = endian::load32<swapped>(buffer + 36);
+
+  recordHeader.dataEndianness = swapped ? 1 : 0;
+  recordHeader.compressedLengthPadding = (recordHeader.bitInfo >> 24) & 0x00000003;
   recordHeader.userHeaderLengthPadding = (recordHeader.bitInfo >> 20) & 0x00000003;
   recordHeader.recordDataLengthCompressed = compressedWord & 0x0FFFFFFF;
   recordHeader.compressionType = (compressedWord >> 28) & 0x0000000F;
   recordHeader.indexDataLength = 4 * recordHeader.numberOfEvents;
+}
 
-  /*printf(" allocating buffer for record, size = %d, padding = %d length = %d type = %d nevents = %d data length =
-    %d\n", dataBufferLengthBytes, compressedDataLengthPadding, recordHeader.recordDataLengthCompressed*4,
-    recordHeader.compressionType, recordHeader.numberOfEvents, recordHeader.recordDataLength);
-    */
-  // char *compressedBuffer    = (char*) malloc(dataBufferLengthBytes);
-
-  if (dataBufferLengthBytes > recordCompressedBuffer.size()) {
-    int newSize = dataBufferLengthBytes + 5 * 1024;
-    recordCompressedBuffer.resize(newSize);
-  }
-  // dataBufferLengthBytes    -= compressedDataLengthPadding;
-  long dataposition = position + headerLengthBytes;
-  // printf("position = %ld data position = %ld\n",position, dataposition);
-  stream.seekg(dataposition, std::ios::beg);
-  // stream.read( compressedBuffer, dataBufferLengthBytes);
-  stream.read((&recordCompressedBuffer[0]), dataBufferLengthBytes);
-  // showBuffer(compressedBuffer, 10, 200);
-  // printf("position = %ld data position = %ld \n",position, dataposition);
-  int decompressedLength = recordHeader.indexDataLength + recordHeader.userHeaderLength +
-                           recordHeader.userHeaderLengthPadding + recordHeader.recordDataLength;
+void record::readHeader(const char *buffer) {
+  if (endian::load32<false>(buffer + 28) == endian::SWAPPED_MAGIC)
+    parseHeader<true>(buffer);
+  else
+    parseHeader<false>(buffer);
+}
 
-  if (recordBuffer.size() < decompressedLength) {
-    recordBuffer.resize(decompressedLength + 1024);
+/**
+ * decompresses the record data (everything after the header) into
+ * recordBuffer with the codec of the record's compression type and
+ * converts the index array from the lengths of the events to their end
+ * positions in the record. With an event limit only the bytes up to the
+ * end of the last needed event are decompressed and the record holds
+ * that many events. A record that can not be decoded is left with no
+ * events and false is returned.
+ */
+template <bool swapped>
+bool record::decodeData(const char *data) {
+  int dataLength = (recordHeader.recordLength - recordHeader.headerLength) * 4;
+  int decompressedLength = getRecordSizeUncompressed();
+  hipo::fitBuffer(recordBuffer, decompressedLength, 1024);
+
+  codec *decoder = codecRegistry::get(recordHeader.compressionType);
+  if (decoder == NULL) {
+    printf("[RECORD] ** error ** compression type %d is not supported by this build\n", recordHeader.compressionType);
+    recordHeader.numberOfEvents = 0;
+    return false;
   }
-  // for(int i = 0; i < recordBuffer.size(); i++) recordBuffer[i] = 0;
-  // printf("****************** BEFORE padding = %d\n", compressedDataLengthPadding);
-  // showBuffer(&recordBuffer[0], 10, 200);
-  if (recordHeader.compressionType == 0) {
-    memcpy((&recordBuffer[0]), (&recordCompressedBuffer[0]), decompressedLength);
+  int srcLength = dataLength - recordHeader.compressedLengthPadding;
+  int needed = decompressedLength;
+  int events = recordHeader.numberOfEvents;
+  int length;
+  profiler::resume(profiler::STAGE_DECOMPRESS);
+  if (eventLimit >= 0 && eventLimit < events) {
+    // the event index comes first, it gives the end of the last event needed
+    events = eventLimit;
+    int indexLength = recordHeader.indexDataLength;
+    length = decoder->decompressPartial(data, srcLength, &recordBuffer[0], indexLength, decompressedLength);
+    if (length >= indexLength) {
+      needed = indexLength + recordHeader.userHeaderLength + recordHeader.userHeaderLengthPadding;
+      for (int i = 0; i < events; i++) needed += endian::load32<swapped>(&recordBuffer[i * 4]);
+      if (needed > length)
+        length = decoder->decompressPartial(data, srcLength, &recordBuffer[0], needed, decompressedLength);
+    }
   } else {
-    int unc_result = getUncompressed((&recordCompressedBuffer[0]), (&recordBuffer[0]),
-                                     dataBufferLengthBytes - compressedDataLengthPadding, decompressedLength);
+    length = decoder->decompress(data, srcLength, &recordBuffer[0], decompressedLength);
   }
-  // printf("******************\n");
-  // showBuffer(&recordBuffer[0], 10, 200);
-  // char *uncompressedBuffer  = getUncompressed(compressedBuffer,dataBufferLengthBytes,recordHeader.recordDataLength);
-  // printf(" decompression size = %d  error = %d\n", unc_result,
-  // unc_result - decompressedLength);
-  // free(compressedBuffer);
-  /**
-   * converting index array from lengths of each buffer in the
-   * record to relative positions in the record stream.
-   */
-  int eventPosition = 0;
-  for (int i = 0; i < recordHeader.numberOfEvents; i++) {
-    int *ptr = reinterpret_cast<int *>(&recordBuffer[i * 4]);
-    int size = *ptr;
-    if (recordHeader.dataEndianness == 1) size = __builtin_bswap32(size);
-    eventPosition += size;
-    *ptr = eventPosition;
+  profiler::pause(profiler::STAGE_DECOMPRESS, needed);
+  if (length < needed) {
+    printf("[RECORD] ** error ** %s decompression failed (%d of %d bytes)\n", decoder->getName(), length, needed);
+    recordHeader.numberOfEvents = 0;
+    return false;
   }
-  // printf("final position = %d\n",eventPosition);
+  recordHeader.numberOfEvents = events;
+
+  profiler::resume(profiler::STAGE_INDEX);
+  endian::lengthsToOffsets<swapped>(&recordBuffer[0], recordHeader.numberOfEvents);
+  profiler::pause(profiler::STAGE_INDEX, 0, recordHeader.numberOfEvents);
+  return true;
+}
+
+bool record::decodeData(const char *data) {
+  if (recordHeader.dataEndianness == 1) return decodeData<true>(data);
+  return decodeData<false>(data);
+}
+
+void record::readRecord(std::ifstream &stream, long position, int dataOffset) {
+  readRecord(stream, position, dataOffset, LONG_MAX);
 }
 
 bool record::readRecord(std::ifstream &stream, long position, int dataOffset, long inputSize) {
   if ((position + 80) >= inputSize) return false;
 
+  profiler::resume(profiler::STAGE_IO);
   recordHeaderBuffer.resize(80);
   stream.seekg(position, std::ios::beg);
+  stream.read((char *)&recordHeaderBuffer[0], 56);
+  profiler::pause(profiler::STAGE_IO, 56);
+  readHeader(&recordHeaderBuffer[0]);
 
-  stream.read((char *)&recordHeaderBuffer[0], 80);
-  recordHeader.recordLength = *(reinterpret_cast<int *>(&recordHeaderBuffer[0]));
-  recordHeader.headerLength = *(reinterpret_cast<int *>(&recordHeaderBuffer[8]));
-  recordHeader.numberOfEvents = *(reinterpret_cast<int *>(&recordHeaderBuffer[12]));
-  recordHeader.bitInfo = *(reinterpret_cast<int *>(&recordHeaderBuffer[20]));
-  recordHeader.signatureString = *(reinterpret_cast<int *>(&recordHeaderBuffer[28]));
-  recordHeader.recordDataLength = *(reinterpret_cast<int *>(&recordHeaderBuffer[32]));
-  recordHeader.userHeaderLength = *(reinterpret_cast<int *>(&recordHeaderBuffer[24]));
-  int compressedWord = *(reinterpret_cast<int *>(&recordHeaderBuffer[36]));
-
-  if (recordHeader.signatureString == 0xc0da0100) recordHeader.dataEndianness = 0;
-  if (recordHeader.signatureString == 0x0001dac0) recordHeader.dataEndianness = 1;
-
-  if (recordHeader.signatureString == 0x0001dac0) {
-    recordHeader.recordLength = __builtin_bswap32(recordHeader.recordLength);
-    recordHeader.headerLength = __builtin_bswap32(recordHeader.headerLength);
-    recordHeader.numberOfEvents = __builtin_bswap32(recordHeader.numberOfEvents);
-    recordHeader.recordDataLength = __builtin_bswap32(recordHeader.recordDataLength);
-    recordHeader.userHeaderLength = __builtin_bswap32(recordHeader.userHeaderLength);
-    recordHeader.bitInfo = __builtin_bswap32(recordHeader.bitInfo);
-    compressedWord = __builtin_bswap32(compressedWord);
-  }
-
-  int compressedDataLengthPadding = (recordHeader.bitInfo >> 24) & 0x00000003;
   int headerLengthBytes = recordHeader.headerLength * 4;
   int dataBufferLengthBytes = recordHeader.recordLength * 4 - headerLengthBytes;
-
-  recordHeader.userHeaderLengthPadding = (recordHeader.bitInfo >> 20) & 0x00000003;
-  recordHeader.recordDataLengthCompressed = compressedWord & 0x0FFFFFFF;
-  recordHeader.compressionType = (compressedWord >> 28) & 0x0000000F;
-  recordHeader.indexDataLength = 4 * recordHeader.numberOfEvents;
-
-  /*printf(" allocating buffer for record, size = %d, padding = %d length = %d type = %d nevents = %d data length =
-    %d\n", dataBufferLengthBytes, compressedDataLengthPadding, recordHeader.recordDataLengthCompressed*4,
-    recordHeader.compressionType, recordHeader.numberOfEvents, recordHeader.recordDataLength);
-    */
-  // char *compressedBuffer    = (char*) malloc(dataBufferLengthBytes);
-
-  if (dataBufferLengthBytes > recordCompressedBuffer.size()) {
-    int newSize = dataBufferLengthBytes + 5 * 1024;
-    recordCompressedBuffer.resize(newSize);
-  }
-  // dataBufferLengthBytes    -= compressedDataLengthPadding;
-  long dataposition = position + headerLengthBytes;
-  // printf("position = %ld data position = %ld\n",position, dataposition);
-  stream.seekg(dataposition, std::ios::beg);
-  // stream.read( compressedBuffer, dataBufferLengthBytes);
-  if (position + dataBufferLengthBytes + recordHeader.headerLength > inputSize) {
-    std::cerr << "**** warning : record at position " << position << "is incomplete." << std::endl;
+  if (position + headerLengthBytes + dataBufferLengthBytes > inputSize) {
+    std::cerr << "**** warning : record at position " << position << " is incomplete." << std::endl;
     return false;
   }
+
+  hipo::fitBuffer(recordCompressedBuffer, dataBufferLengthBytes, 5 * 1024);
+  profiler::resume(profiler::STAGE_IO);
+  stream.seekg(position + headerLengthBytes, std::ios::beg);
   stream.read((&recordCompressedBuffer[0]), dataBufferLengthBytes);
-  // showBuffer(compressedBuffer, 10, 200);
-  // printf("position = %ld data position = %ld \n",position, dataposition);
-  int decompressedLength = recordHeader.indexDataLength + recordHeader.userHeaderLength +
-                           recordHeader.userHeaderLengthPadding + recordHeader.recordDataLength;
+  profiler::pause(profiler::STAGE_IO, dataBufferLengthBytes);
 
-  if (recordBuffer.size() < decompressedLength) {
-    recordBuffer.resize(decompressedLength + 1024);
-  }
-  // for(int i = 0; i < recordBuffer.size(); i++) recordBuffer[i] = 0;
-  // printf("****************** BEFORE padding = %d\n", compressedDataLengthPadding);
-  // showBuffer(&recordBuffer[0], 10, 200);
-  if (recordHeader.compressionType == 0) {
-    memcpy((&recordBuffer[0]), (&recordCompressedBuffer[0]), decompressedLength);
-  } else {
-    int unc_result = getUncompressed((&recordCompressedBuffer[0]), (&recordBuffer[0]),
-                                     dataBufferLengthBytes - compressedDataLengthPadding, decompressedLength);
-  }
-  // printf("******************\n");
-  // showBuffer(&recordBuffer[0], 10, 200);
-  // char *uncompressedBuffer  = getUncompressed(compressedBuffer,dataBufferLengthBytes,recordHeader.recordDataLength);
-  // printf(" decompression size = %d  error = %d\n", unc_result,
-  // unc_result - decompressedLength);
-  // free(compressedBuffer);
-  /**
-   * converting index array from lengths of each buffer in the
-   * record to relative positions in the record stream.
-   */
-  int eventPosition = 0;
-  for (int i = 0; i < recordHeader.numberOfEvents; i++) {
-    int *ptr = reinterpret_cast<int *>(&recordBuffer[i * 4]);
-    int size = *ptr;
-    if (recordHeader.dataEndianness == 1) size = __builtin_bswap32(size);
-    eventPosition += size;
-    *ptr = eventPosition;
-  }
+  return decodeData(&recordCompressedBuffer[0]);
+}
 
-  return true;
+/**
+ * decodes a record that is already in memory (header and data, as
+ * delivered by the read-ahead), false if the buffer is shorter than
+ * the record.
+ */
+bool record::readRecord(const char *buffer, long length) {
+  if (length < 56) return false;
+  readHeader(buffer);
+  if (recordHeader.recordLength * 4L > length) return false;
+  return decodeData(buffer + recordHeader.headerLength * 4);
 }
 
 int record::getRecordSizeCompressed() { return recordHeader.recordLength; }
+/**
+ * returns the size of the decompressed record payload in bytes
+ * (event index, user header and events).
+ */
+int record::getRecordSizeUncompressed() {
+  return recordHeader.indexDataLength + recordHeader.userHeaderLength + recordHeader.userHeaderLengthPadding +
+         recordHeader.recordDataLength;
+}
+/**
+ * reads the whole record (recordLength bytes) with one read and
+ * decodes it from memory.
+ */
 void record::readRecord__(std::ifstream &stream, long position, long recordLength) {
+  hipo::fitBuffer(recordCompressedBuffer, recordLength, 5 * 1024);
+  profiler::resume(profiler::STAGE_IO);
   stream.seekg(position, std::ios::beg);
-
-  if (recordLength > recordCompressedBuffer.size()) {
-    int newSize = recordLength + 5 * 1024;
-    // printf("---> resizing internal compressed buffer size to from %ld to %d\n",
-    // recordCompressedBuffer.size(), newSize);
-    // printf("---> after printout\n");
-    recordCompressedBuffer.resize(newSize);
-  }
-  // printf(" trying seeksg\n");
-  stream.seekg(position, std::ios::beg);
-  // printf(" trying read\n");
   stream.read((&recordCompressedBuffer[0]), recordLength);
-  // printf(" readin was successfull....\n");
-  // stream.read( (char *) &recordHeaderBuffer[0],80);
-  recordHeader.recordLength = *(reinterpret_cast<int *>(&recordCompressedBuffer[0]));
-  recordHeader.headerLength = *(reinterpret_cast<int *>(&recordCompressedBuffer[8]));
-  recordHeader.numberOfEvents = *(reinterpret_cast<int *>(&recordCompressedBuffer[12]));
-  recordHeader.bitInfo = *(reinterpret_cast<int *>(&recordCompressedBuffer[20]));
-  recordHeader.signatureString = *(reinterpret_cast<int *>(&recordCompressedBuffer[28]));
-  recordHeader.recordDataLength = *(reinterpret_cast<int *>(&recordCompressedBuffer[32]));
-  recordHeader.userHeaderLength = *(reinterpret_cast<int *>(&recordCompressedBuffer[24]));
-  int compressedWord = *(reinterpret_cast<int *>(&recordCompressedBuffer[36]));
-
-  if (recordHeader.signatureString == 0xc0da0100) recordHeader.dataEndianness = 0;
-  if (recordHeader.signatureString == 0x0001dac0) recordHeader.dataEndianness = 1;
-
-  if (recordHeader.signatureString == 0x0001dac0) {
-    recordHeader.recordLength = __builtin_bswap32(recordHeader.recordLength);
-    recordHeader.headerLength = __builtin_bswap32(recordHeader.headerLength);
-    recordHeader.numberOfEvents = __builtin_bswap32(recordHeader.numberOfEvents);
-    recordHeader.recordDataLength = __builtin_bswap32(recordHeader.recordDataLength);
-    recordHeader.userHeaderLength = __builtin_bswap32(recordHeader.userHeaderLength);
-    recordHeader.bitInfo = __builtin_bswap32(recordHeader.bitInfo);
-    compressedWord = __builtin_bswap32(compressedWord);
-  }
-
-  int compressedDataLengthPadding = (recordHeader.bitInfo >> 24) & 0x00000003;
-  int headerLengthBytes = recordHeader.headerLength * 4;
-  int dataBufferLengthBytes = recordHeader.recordLength * 4 - headerLengthBytes;
-
-  recordHeader.userHeaderLengthPadding = (recordHeader.bitInfo >> 20) & 0x00000003;
-  recordHeader.recordDataLengthCompressed = compressedWord & 0x0FFFFFFF;
-  recordHeader.compressionType = (compressedWord >> 28) & 0x0000000F;
-  recordHeader.indexDataLength = 4 * recordHeader.numberOfEvents;
-
-  /*printf(" allocating buffer for record, size = %d, padding = %d length = %d type = %d nevents = %d data length =
-    %d\n", dataBufferLengthBytes, compressedDataLengthPadding, recordHeader.recordDataLengthCompressed*4,
-    recordHeader.compressionType, recordHeader.numberOfEvents, recordHeader.recordDataLength);
-    */
-  // char *compressedBuffer    = (char*) malloc(dataBufferLengthBytes);
-
-  // dataBufferLengthBytes    -= compressedDataLengthPadding;
-  // printf(" record header intialized....\n");
-  long dataposition = position + headerLengthBytes;
-  // printf("position = %ld data position = %ld\n",position, dataposition);
-  // stream.seekg(dataposition,std::ios::beg);
-  // stream.read( compressedBuffer, dataBufferLengthBytes);
-  // stream.read( (&recordCompressedBuffer[0]), dataBufferLengthBytes);
-  // showBuffer(compressedBuffer, 10, 200);
-  // printf("position = %ld data position = %ld \n",position, dataposition);
-  int decompressedLength = recordHeader.indexDataLength + recordHeader.userHeaderLength +
-                           recordHeader.userHeaderLengthPadding + recordHeader.recordDataLength;
-  // printf(" decompressed length = %d\n",decompressedLength);
-  if (recordBuffer.size() < decompressedLength) {
-    // printf(" resizing internal buffer from %lu to %d\n", recordBuffer.size(), recordHeader.recordDataLength);
-    recordBuffer.resize(decompressedLength + 1024);
-  }
-  // for(int i = 0; i < recordBuffer.size(); i++) recordBuffer[i] = 0;
-  // printf("****************** BEFORE padding = %d\n", compressedDataLengthPadding);
-  // showBuffer(&recordBuffer[0], 10, 200);
-  if (recordHeader.compressionType == 0) {
-    // printf("compression type = 0 data length = %d\n",decompressedLength);
-    memcpy((&recordBuffer[0]), (&recordCompressedBuffer[0]), decompressedLength);
-  } else {
-    // printf(" running deompression %d %d
-    // %d\n",dataBufferLengthBytes-compressedDataLengthPadding,decompressedLength,dataposition);
-    int unc_result = getUncompressed((&recordCompressedBuffer[56]), (&recordBuffer[0]),
-                                     dataBufferLengthBytes - compressedDataLengthPadding, decompressedLength);
-    // printf("end running deompression %d\n",unc_result);
-  }
-  // printf("******************\n");
-  // showBuffer(&recordBuffer[0], 10, 200);
-  // char *uncompressedBuffer  = getUncompressed(compressedBuffer,dataBufferLengthBytes,recordHeader.recordDataLength);
-  // printf(" decompression size = %d  error = %d\n", unc_result,
-  // unc_result - decompressedLength);
-  // free(compressedBuffer);
-  /**
-   * converting index array from lengths of each buffer in the
-   * record to relative positions in the record stream.
-   */
-  // printf(" deompression ..... ok \n");
-  int eventPosition = dataposition;
-  for (int i = 0; i < recordHeader.numberOfEvents; i++) {
-    int *ptr = reinterpret_cast<int *>(&recordBuffer[i * 4]);
-    int size = *ptr;
-    if (recordHeader.dataEndianness == 1) size = __builtin_bswap32(size);
-    eventPosition += size;
-    *ptr = eventPosition;
-  }
-  // printf("final position = %d\n",eventPosition);
+  profiler::pause(profiler::STAGE_IO, recordLength);
+  readRecord(&recordCompressedBuffer[0], recordLength);
 }
 /**
  * returns number of events in the record.
@@ -336,13 +196,14 @@ void record::getData(hipo::data &data, int index) {
   data.setDataPtr(&recordBuffer[first_position + offset]);
   data.setDataSize(last_position - first_position);
   data.setDataOffset(first_position + offset);
+  data.setDataEndianness(recordHeader.dataEndianness);
 }
 
 void record::readHipoEvent(hipo::event &event, int index) {
   hipo::data event_data;
   getData(event_data, index);
   // printf("reading event %d ptr=%X size=%d\n",index,(unsigned long) event_data.getDataPtr(),event_data.getDataSize());
-  event.init(event_data.getDataPtr(), event_data.getDataSize());
+  event.init(event_data.getDataPtr(), event_data.getDataSize(), recordHeader.dataEndianness == 1);
 }
 /**
  * prints the content of given buffer in HEX format. Used for debugging.
@@ -354,48 +215,5 @@ void record::showBuffer(const char *data, int wrapping, int maxsize) {
   }
   printf("\n");
 }
-/**
- * decompresses the buffer given with pointed *data, into a destination array
- * provided. The arguments indicate the compressed data length (dataLength),
- * and maximum decompressed length.
- * returns the number of bytes that were decompressed by LZ4
- */
-int record::getUncompressed(const char *data, char *dest, int dataLength, int dataLengthUncompressed) {
-#ifdef __LZ4__
-  int result = LZ4_decompress_safe(data, dest, dataLength, dataLengthUncompressed);
-  // int result = LZ4_decompress_fast(data,dest,dataLengthUncompressed);
-  return result;
-#endif
-
-#ifndef __LZ4__
-  printf("\n   >>>>> LZ4 compression is not supported.");
-  printf("\n   >>>>> check if libz4 is installed on your system.");
-  printf("\n   >>>>> recompile the library with liblz4 installed.\n");
-  return NULL;
-#endif
-}
-/**
- * deompresses the content of given buffer ( *data), into a newly allocated
- * memory. User is responsible for free-ing the allocated memory.
- */
-char *record::getUncompressed(const char *data, int dataLength, int dataLengthUncompressed) {
-#ifdef __LZ4__
-  char *output = (char *)malloc(dataLengthUncompressed);
-  int result = LZ4_decompress_safe(data, output, dataLength, dataLengthUncompressed);
-  // int   result = LZ4_decompress_fast(data,output,dataLengthUncompressed);
-  return output;
-// printf(" FIRST (%d) = %x %x %x %x\n",result);//,destUnCompressed[0],destUnCompressed[1],
-// destUnCompressed[2],destUnCompressed[3]);
-// LZ4_decompress_fast(buffer,destUnCompressed,decompressedLength);
-// LZ4_uncompress(buffer,destUnCompressed,decompressedLength);
-#endif
-
-#ifndef __LZ4__
-  printf("\n   >>>>> LZ4 compression is not supported.");
-  printf("\n   >>>>> check if libz4 is installed on your system.");
-  printf("\n   >>>>> recompile the library with liblz4 installed.\n");
-  return NULL;
-#endif
-}
 
 }  // namespace hipo
@@ -22,6 +22,7 @@
 #include <string>
 #include <vector>
 
+#include "buffer.h"
 #include "event.h"
 
 namespace hipo {
@@ -75,22 +76,39 @@ class record {
   std::vector<char> recordHeaderBuffer;
   recordHeader_t recordHeader;
 
-  std::vector<char> recordBuffer;
-  std::vector<char> recordCompressedBuffer;
+  hipo::byteBuffer recordBuffer;
+  hipo::byteBuffer recordCompressedBuffer;
+  int eventLimit;
 
-  char *getUncompressed(const char *data, int dataLength, int dataLengthUncompressed);
-  int getUncompressed(const char *data, char *dest, int dataLength, int dataLengthUncompressed);
   void showBuffer(const char *data, int wrapping, int maxsize);
 
+  /** header parsing and data decoding, instantiated for both byte orders */
+  template <bool swapped>
+  void parseHeader(const char *buffer);
+  template <bool swapped>
+  bool decodeData(const char *data);
+  void readHeader(const char *buffer);
+  bool decodeData(const char *data);
+
  public:
   record();
   ~record();
 
+  /**
+   * decode only the first n events of the records read from now on
+   * (-1 decodes all), getEventCount() is then at most n.
+   */
+  void setEventLimit(int n) { eventLimit = n; }
+
   void readRecord(std::ifstream &stream, long position, int dataOffset);
   void readRecord__(std::ifstream &stream, long position, long recordLength);
   bool readRecord(std::ifstream &stream, long position, int dataOffset, long inputSize);
+  bool readRecord(const char *buffer, long length);
   int getEventCount();
   int getRecordSizeCompressed();
+  int getRecordSizeUncompressed();
+  /** memory held by the record buffers in bytes */
+  long getMemorySize() { return recordBuffer.capacity() + recordCompressedBuffer.capacity() + recordHeaderBuffer.capacity(); }
   void readEvent(std::vector<char> &vec, int index);
   void readHipoEvent(hipo::event &event, int index);
   void getData(hipo::data &data, int index);
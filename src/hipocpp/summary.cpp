@@ -0,0 +1,208 @@
+/*
+ * Per record bank summary, see summary.h
+ */
+
+#include "summary.h"
+
+#include "event.h"
+#include "reader.h"
+#include "record.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+
+namespace hipo {
+
+namespace {
+const int SUMMARY_MAGIC = 0x4d555348;  // "HSUM"
+const int SUMMARY_VERSION = 1;
+
+template <class T>
+void put(FILE *file, T value) {
+  fwrite(&value, sizeof(T), 1, file);
+}
+
+template <class T>
+bool get(FILE *file, T &value) {
+  return fread(&value, sizeof(T), 1, file) == 1;
+}
+}  // namespace
+
+std::string fileSummary::sidecarName(const char *filename) { return std::string(filename) + ".summary"; }
+
+bool fileSummary::fileStatus(const char *filename, long &size, long &time) {
+  struct stat info;
+  if (stat(filename, &info) != 0 || S_ISREG(info.st_mode) == false) return false;
+  size = info.st_size;
+  time = info.st_mtime;
+  return true;
+}
+
+void fileSummary::build(hipo::reader &reader, const char *filename) {
+  *this = fileSummary();
+  fileStatus(filename, fileSize, fileTime);
+
+  // rows per (record, group), the groups are only known at the end
+  std::vector<std::map<int, int> > content;
+  std::vector<int> allGroups;
+  hipo::record record;
+  hipo::event event;
+  std::vector<std::pair<int, int> > rows;
+  for (int r = 0; r < reader.getRecordCount(); r++) {
+    reader.readRecord(record, r);
+    positions.push_back(reader.getRecordPosition(r));
+    events.push_back(record.getEventCount());
+    content.push_back(std::map<int, int>());
+    std::map<int, int> &maxima = content.back();
+    for (int e = 0; e < record.getEventCount(); e++) {
+      record.readHipoEvent(event, e);
+      event.getBankRows(rows);
+      for (int i = 0; i < rows.size(); i++) {
+        std::map<int, int>::iterator it = maxima.find(rows[i].first);
+        if (it == maxima.end()) {
+          maxima[rows[i].first] = rows[i].second;
+          allGroups.push_back(rows[i].first);
+        } else if (it->second < rows[i].second) {
+          it->second = rows[i].second;
+        }
+      }
+    }
+  }
+
+  std::sort(allGroups.begin(), allGroups.end());
+  allGroups.erase(std::unique(allGroups.begin(), allGroups.end()), allGroups.end());
+  groups = allGroups;
+  words = (groups.size() + 63) / 64;
+  bitmaps.assign(positions.size() * words, 0);
+  for (int r = 0; r < content.size(); r++) {
+    rowsOffset.push_back(maxRows.size());
+    // both the map and the group list are sorted, the bits come in order
+    int bit = 0;
+    for (std::map<int, int>::iterator it = content[r].begin(); it != content[r].end(); ++it) {
+      while (groups[bit] != it->first) bit++;
+      bitmaps[r * words + bit / 64] |= (1ULL << (bit % 64));
+      maxRows.push_back(it->second);
+    }
+  }
+}
+
+bool fileSummary::write(const char *filename) {
+  FILE *file = fopen(filename, "wb");
+  if (file == NULL) {
+    printf("[SUMMARY] ** error ** can not write file %s\n", filename);
+    return false;
+  }
+  put<int32_t>(file, SUMMARY_MAGIC);
+  put<int32_t>(file, SUMMARY_VERSION);
+  put<int64_t>(file, fileSize);
+  put<int64_t>(file, fileTime);
+  put<int32_t>(file, groups.size());
+  for (int i = 0; i < groups.size(); i++) put<int32_t>(file, groups[i]);
+  put<int32_t>(file, positions.size());
+  for (int r = 0; r < positions.size(); r++) {
+    put<int64_t>(file, positions[r]);
+    put<int32_t>(file, events[r]);
+    if (words > 0) fwrite(&bitmaps[r * words], sizeof(uint64_t), words, file);
+    int end = (r + 1 < positions.size()) ? rowsOffset[r + 1] : maxRows.size();
+    for (int i = rowsOffset[r]; i < end; i++) put<int32_t>(file, maxRows[i]);
+  }
+  bool status = (ferror(file) == 0);
+  if (fclose(file) != 0) status = false;
+  if (status == false) printf("[SUMMARY] ** error ** writing file %s failed\n", filename);
+  return status;
+}
+
+bool fileSummary::read(const char *filename, const char *hipoFile) {
+  *this = fileSummary();
+  FILE *file = fopen(filename, "rb");
+  if (file == NULL) return false;
+  int32_t magic = 0, version = 0, count = 0;
+  int64_t size = 0, time = 0;
+  bool status = get(file, magic) && magic == SUMMARY_MAGIC && get(file, version) && version == SUMMARY_VERSION &&
+                get(file, size) && get(file, time) && get(file, count) && count >= 0;
+  if (status == false) {
+    printf("[SUMMARY] ** error ** %s is not a bank summary\n", filename);
+    fclose(file);
+    return false;
+  }
+  long currentSize, currentTime;
+  if (fileStatus(hipoFile, currentSize, currentTime) == false || currentSize != size || currentTime != time) {
+    printf("[SUMMARY] %s is older than the file, it is not used\n", filename);
+    fclose(file);
+    return false;
+  }
+  fileSize = size;
+  fileTime = time;
+  groups.resize(count);
+  for (int i = 0; i < count && status == true; i++) status = get(file, groups[i]);
+  words = (groups.size() + 63) / 64;
+  int32_t records = 0;
+  status = status && get(file, records) && records >= 0;
+  for (int r = 0; r < records && status == true; r++) {
+    int64_t position;
+    int32_t n;
+    status = get(file, position) && get(file, n);
+    positions.push_back(position);
+    events.push_back(n);
+    rowsOffset.push_back(maxRows.size());
+    int bits = 0;
+    for (int w = 0; w < words && status == true; w++) {
+      uint64_t word;
+      status = get(file, word);
+      bitmaps.push_back(word);
+      bits += __builtin_popcountll(word);
+    }
+    for (int i = 0; i < bits && status == true; i++) {
+      int32_t rows;
+      status = get(file, rows);
+      maxRows.push_back(rows);
+    }
+  }
+  fclose(file);
+  if (status == false) {
+    printf("[SUMMARY] ** error ** %s is incomplete\n", filename);
+    *this = fileSummary();
+  }
+  return status;
+}
+
+int fileSummary::findRecord(long position) {
+  std::vector<long>::iterator it = std::lower_bound(positions.begin(), positions.end(), position);
+  if (it == positions.end() || *it != position) return -1;
+  return it - positions.begin();
+}
+
+int fileSummary::getMaxRows(int record, int group) {
+  std::vector<int>::iterator it = std::lower_bound(groups.begin(), groups.end(), group);
+  if (it == groups.end() || *it != group) return 0;
+  int bit = it - groups.begin();
+  const uint64_t *bitmap = &bitmaps[record * words];
+  if ((bitmap[bit / 64] & (1ULL << (bit % 64))) == 0) return 0;
+  // entries of maxRows follow the bits set before this one
+  int entry = rowsOffset[record];
+  for (int w = 0; w < bit / 64; w++) entry += __builtin_popcountll(bitmap[w]);
+  entry += __builtin_popcountll(bitmap[bit / 64] & ((1ULL << (bit % 64)) - 1));
+  return maxRows[entry];
+}
+
+bool fileSummary::mayHave(int record, int group, int minRows) {
+  return getMaxRows(record, group) >= std::max(minRows, 1);
+}
+
+void fileSummary::show() {
+  printf("[SUMMARY] %d records, %d bank groups\n", getRecordCount(), (int)groups.size());
+  for (int i = 0; i < groups.size(); i++) {
+    int records = 0, largest = 0;
+    for (int r = 0; r < positions.size(); r++) {
+      int rows = getMaxRows(r, groups[i]);
+      if (rows > 0) records++;
+      if (rows > largest) largest = rows;
+    }
+    printf("[SUMMARY] group %6d : in %6d records, at most %6d rows\n", groups[i], records, largest);
+  }
+}
+
+}  // namespace hipo
@@ -0,0 +1,71 @@
+/*
+ * File:   summary.h
+ *
+ * Bank content of every record of a file, kept in a sidecar file next
+ * to it (<file>.summary). For each record there is a bitmap of the bank
+ * groups found in any of its events and, for the groups present, the
+ * largest number of rows in one event. A reader with a bank filter
+ * (reader::requireBank) skips the records that can not hold a passing
+ * event without reading them.
+ *
+ * The sidecar is written once with build() (dst2root --summary), it
+ * stores the size and modification time of the file and is ignored
+ * when the file changed since.
+ */
+
+#ifndef HIPO_SUMMARY_H
+#define HIPO_SUMMARY_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace hipo {
+
+class reader;
+class record;
+
+class fileSummary {
+ private:
+  std::vector<int> groups;          // sorted, bit i of a bitmap is groups[i]
+  int words;                        // bitmap words per record
+  std::vector<long> positions;      // record positions in the file, increasing
+  std::vector<int> events;          // events per record
+  std::vector<uint64_t> bitmaps;    // words per record, one after the other
+  std::vector<int> rowsOffset;      // first entry of each record in maxRows
+  std::vector<int> maxRows;         // one entry per bit set, in bit order
+  long fileSize;
+  long fileTime;
+
+  static bool fileStatus(const char *filename, long &size, long &time);
+
+ public:
+  fileSummary() {
+    words = 0;
+    fileSize = 0;
+    fileTime = 0;
+  }
+
+  /** name of the sidecar of a HIPO file */
+  static std::string sidecarName(const char *filename);
+
+  /** reads every record of the file (opened in random access mode) */
+  void build(hipo::reader &reader, const char *filename);
+  bool write(const char *filename);
+  /** reads the sidecar, false when it is missing or older than the file */
+  bool read(const char *filename, const char *hipoFile);
+
+  bool isEmpty() { return positions.empty(); }
+  int getRecordCount() { return positions.size(); }
+  /** index of the record at position, -1 if it is not in the summary */
+  int findRecord(long position);
+  /** largest row count of the bank group in one event of the record, 0 if it is never there */
+  int getMaxRows(int record, int group);
+  /** false when no event of the record has at least minRows rows of the bank group */
+  bool mayHave(int record, int group, int minRows);
+  void show();
+};
+
+}  // namespace hipo
+
+#endif /* HIPO_SUMMARY_H */
@@ -123,6 +123,56 @@ std::string utils::getFileTrailer(const char *code) {
   file_trailer.append("//###### ENF OF GENERATED FILE #######\n");
   return file_trailer;
 }
+/**
+ * preamble of the generated bank accessor header (see
+ * dictionary::getBanksCode), it defines the item descriptor and the
+ * node scan shared by all bank structures.
+ */
+std::string utils::getBanksFileHeader() {
+  std::string file_header;
+  file_header.append(hipo::utils::getHeader());
+  file_header.append("\n#ifndef HIPO_BANKS_H\n#define HIPO_BANKS_H\n\n");
+  file_header.append("#include <cstdint>\n#include <cstring>\n\n#include \"event.h\"\n\n");
+  file_header.append("namespace banks {\n\n");
+  file_header.append("/** one item of a bank : name, item id and HIPO type */\n");
+  file_header.append("struct item_t {\n  const char *name;\n  int item;\n  int type;\n};\n\n");
+  file_header.append("constexpr int typeSize(int type) {\n");
+  file_header.append("  return (type == 1) ? 1 : (type == 2) ? 2 : (type == 5 || type == 8) ? 8 : 4;\n}\n\n");
+  file_header.append("template <class T>\ninline T value(const char *node, int row) {\n");
+  file_header.append("  T v;\n  std::memcpy(&v, node + row * sizeof(T), sizeof(T));\n  return v;\n}\n\n");
+  file_header.append("/**\n * finds the nodes of Bank in the event with one pass over the event,\n");
+  file_header.append(" * returns the number of rows, 0 when an item is missing, has another\n");
+  file_header.append(" * type than in the dictionary or the items have different lengths.\n");
+  file_header.append(" * The node pointers come from getNodePtr(), which swaps the payload of\n");
+  file_header.append(" * a node from a big endian file in place the first time.\n */\n");
+  file_header.append("template <class Bank>\ninline int readBank(hipo::event &event, const char **nodes) {\n");
+  file_header.append("  const char *data = event.getDataPtr();\n");
+  file_header.append("  int size = event.getDataSize();\n");
+  file_header.append("  int found = 0;\n  int rows = -1;\n");
+  file_header.append("  for (int i = 0; i < Bank::entries; i++) nodes[i] = nullptr;\n");
+  file_header.append("  for (int position = 16; position + 8 < size;) {\n");
+  file_header.append("    int group = event.getNodeGroup(position);\n");
+  file_header.append("    int length = event.getNodeLength(position);\n");
+  file_header.append("    if (group == Bank::group) {\n");
+  file_header.append("      int slot = Bank::slot((uint8_t)data[position + 2]);\n");
+  file_header.append("      int type = (uint8_t)data[position + 3];\n");
+  file_header.append("      if (slot < 0 || nodes[slot] != nullptr) {\n        position += length + 8;\n        continue;\n      }\n");
+  file_header.append("      if (type != Bank::items[slot].type) return 0;\n");
+  file_header.append("      int n = length / typeSize(type);\n");
+  file_header.append("      if (rows >= 0 && n != rows) return 0;\n");
+  file_header.append("      rows = n;\n      nodes[slot] = event.getNodePtr(position);\n");
+  file_header.append("      if (++found == Bank::entries) return rows;\n    }\n");
+  file_header.append("    position += length + 8;\n  }\n  return 0;\n}\n\n");
+  return file_header;
+}
+
+std::string utils::getBanksFileTrailer() {
+  std::string file_trailer;
+  file_trailer.append("}  // namespace banks\n\n#endif\n");
+  file_trailer.append("//###### ENF OF GENERATED FILE #######\n");
+  return file_trailer;
+}
+
 std::string utils::getSConstruct() {
   std::string std__string;
   std__string.append("#=================================================\n");
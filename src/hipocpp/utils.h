@@ -38,6 +38,8 @@ class utils {
   static std::string getHeader();
   static std::string getFileHeader();
   static std::string getFileTrailer(const char *code);
+  static std::string getBanksFileHeader();
+  static std::string getBanksFileTrailer();
   static std::string getSConstruct();
 };
 
@@ -1,48 +1,189 @@
+#include "wrapper.h"
+#include <atomic>
 #include <iostream>
+#include <mutex>
+#include <thread>
 #include "event.h"
+#include "hiposwap.h"
 #include "reader.h"
 
-hipo::reader hipo_FORT_Reader;
-hipo::record hipo_FORT_Record;
-hipo::record hipo_FORT_Record_Dictionary;
-hipo::event hipo_FORT_Event;
+/**
+ * state behind one handle, the file is opened in random access mode
+ * so both sequential and record reading work on it.
+ */
+struct hipo_handle {
+  std::string filename;
+  hipo::reader reader;
+  hipo::record record;
+  hipo::record dictionary;
+  hipo::event event;
+  hipo::event *current;  // event the column reads use
+  hipo_handle() : reader(true), current(NULL) {}
+};
+
+static std::vector<hipo_handle *> hipo_FORT_Handles;
+static std::mutex hipo_FORT_Lock;
+static int hipo_FORT_Default = 0;
+
+static int openHandle(const char *filename, bool verbose) {
+  hipo_handle *h = new hipo_handle();
+  h->filename = filename;
+  h->reader.open(filename);
+  if (verbose) h->reader.showInfo();
+  h->reader.readHeaderRecord(h->dictionary);
+  h->current = h->reader.getEvent();
+
+  std::lock_guard<std::mutex> guard(hipo_FORT_Lock);
+  for (int i = 0; i < hipo_FORT_Handles.size(); i++) {
+    if (hipo_FORT_Handles[i] == NULL) {
+      hipo_FORT_Handles[i] = h;
+      return i + 1;
+    }
+  }
+  hipo_FORT_Handles.push_back(h);
+  return hipo_FORT_Handles.size();
+}
+
+static hipo_handle *getHandle(int handle) {
+  std::lock_guard<std::mutex> guard(hipo_FORT_Lock);
+  if (handle < 1 || handle > hipo_FORT_Handles.size() || hipo_FORT_Handles[handle - 1] == NULL) {
+    printf("[FORTRAN] ** error ** invalid handle : %d\n", handle);
+    exit(1);
+  }
+  return hipo_FORT_Handles[handle - 1];
+}
+
+/**
+ * returns the node (group, item) of an event buffer, NULL if the event
+ * does not have it. type and length (in bytes) are set from the node,
+ * the headers of events from big endian files are swapped (swapped).
+ */
+template <bool swapped>
+static const char *findNode(const char *event, int size, int group, int item, int &type, int &length) {
+  int position = 16;
+  while (position + 8 < size) {
+    uint16_t gid = hipo::endian::load16<swapped>(event + position);
+    uint8_t iid = (uint8_t)event[position + 2];
+    length = hipo::endian::load32<swapped>(event + position + 4);
+    if (gid == group && iid == item) {
+      type = (uint8_t)event[position + 3];
+      return event + position + 8;
+    }
+    position += (length + 8);
+  }
+  return NULL;
+}
+
+template <class S, class T>
+static int copyValues(const char *ptr, int count, T *buffer, int max, bool swapped) {
+  S value;
+  for (int i = 0; i < count && i < max; i++) {
+    std::memcpy(&value, ptr + i * sizeof(S), sizeof(S));
+    if (swapped == true && sizeof(S) > 1) hipo::endian::swapArray(reinterpret_cast<char *>(&value), 1, sizeof(S));
+    buffer[i] = (T)value;
+  }
+  return count;
+}
+
+/**
+ * converts a node of any numeric type into buffer, returns the number
+ * of rows in the node (at most max are copied). swapped is set for
+ * payloads still in the byte order of a big endian file.
+ */
+template <class T>
+static int copyNode(const char *ptr, int type, int length, T *buffer, int max, bool swapped = false) {
+  if (ptr == NULL) return 0;
+  switch (type) {
+    case 1:
+      return copyValues<int8_t>(ptr, length, buffer, max, false);
+    case 2:
+      return copyValues<int16_t>(ptr, length / 2, buffer, max, swapped);
+    case 3:
+      return copyValues<int32_t>(ptr, length / 4, buffer, max, swapped);
+    case 4:
+      return copyValues<float>(ptr, length / 4, buffer, max, swapped);
+    case 5:
+      return copyValues<double>(ptr, length / 8, buffer, max, swapped);
+    case 8:
+      return copyValues<int64_t>(ptr, length / 8, buffer, max, swapped);
+  }
+  return 0;
+}
+
+template <class T>
+static void readColumn(int handle, int group, int item, int *nread, T *buffer, int max) {
+  hipo::event *event = getHandle(handle)->current;
+  int address = event->getEventNode(group, item);
+  if (address < 0) {
+    *nread = 0;
+    return;
+  }
+  *nread = copyNode(event->getNodePtr(address), event->getNodeType(address), event->getNodeLength(address), buffer,
+                    max);
+}
+
+template <class T>
+static void readRecordColumn(int handle, int group, int item, int *n_events, int *offsets, T *buffer, int max,
+                             int *nread) {
+  hipo_handle *h = getHandle(handle);
+  int events = h->record.getEventCount();
+  int total = 0;
+  hipo::data data;
+  for (int i = 0; i < events; i++) {
+    offsets[i] = total;
+    h->record.getData(data, i);
+    // the record buffer is shared, big endian values are swapped while they are copied
+    bool swapped = (data.getDataEndianness() == 1);
+    int type = 0;
+    int length = 0;
+    const char *ptr = swapped ? findNode<true>(data.getDataPtr(), data.getDataSize(), group, item, type, length)
+                              : findNode<false>(data.getDataPtr(), data.getDataSize(), group, item, type, length);
+    total += copyNode(ptr, type, length, buffer + (total < max ? total : max), total < max ? max - total : 0, swapped);
+  }
+  offsets[events] = total;
+  *n_events = events;
+  *nread = total;
+}
 
 extern "C" {
 
-void hipo_open_file_(int *nrecords, const char *filename, int length) {
-  char *buffer = (char *)malloc(length + 1);
-  memcpy(buffer, filename, length);
-  buffer[length] = '\0';
-  printf("[FORTRAN] opening file : %s\n", buffer);
-  hipo_FORT_Reader.open(buffer);
-  hipo_FORT_Reader.showInfo();
-  hipo_FORT_Reader.readHeaderRecord(hipo_FORT_Record_Dictionary);
-  int dictionary_event_count = hipo_FORT_Record_Dictionary.getEventCount();
-  printf("[FORTRAN] dictionary length %d\n", dictionary_event_count);
-  *nrecords = hipo_FORT_Reader.getRecordCount();
-  free(buffer);
-}
-
-int hipo_file_next_(int *fstatus) {
-  bool status = hipo_FORT_Reader.next();
+void hipo_open_handle_(int *handle, int *nrecords, const char *filename, int length) {
+  std::string name(filename, length);
+  name.erase(name.find_last_not_of(' ') + 1);  // Fortran strings are blank padded
+  *handle = openHandle(name.c_str(), false);
+  *nrecords = getHandle(*handle)->reader.getRecordCount();
+}
+
+void hipo_close_handle_(int *handle) {
+  hipo_handle *h = getHandle(*handle);
+  {
+    std::lock_guard<std::mutex> guard(hipo_FORT_Lock);
+    hipo_FORT_Handles[*handle - 1] = NULL;
+  }
+  delete h;
+}
+
+int hipo_handle_next_(int *handle, int *fstatus) {
+  hipo_handle *h = getHandle(*handle);
+  bool status = h->reader.next();
   if (status == false) {
     *fstatus = 12;
     return 12;
   }
-  hipo_FORT_Reader.getEvent()->scanEventMap();
+  h->current = h->reader.getEvent();
+  h->current->scanEventMap();
   *fstatus = 0;
   return 0;
 }
 
-void get_dict_length_(int *len) { *len = hipo_FORT_Record_Dictionary.getEventCount(); }
+void hipo_handle_dict_length_(int *handle, int *len) { *len = getHandle(*handle)->dictionary.getEventCount(); }
 
-void read_schema_(int *order, int *max_char, int *str_Length, char *entry, int entryLength) {
+void hipo_handle_read_schema_(int *handle, int *order, int *max_char, int *str_Length, char *entry, int entryLength) {
   int i = *order;
   hipo::event schema;
-  hipo_FORT_Record_Dictionary.readHipoEvent(schema, i);
+  getHandle(*handle)->dictionary.readHipoEvent(schema, i);
   std::string schemaString = schema.getString(31111, 1);
   int length = schemaString.length();
-  // printf("schema %d (%d) : %s \n",i,length,schemaString.c_str());
   for (int k = 0; k < length; k++) {
     entry[k] = schemaString[k];
   }
@@ -53,67 +194,108 @@ void read_schema_(int *order, int *max_char, int *str_Length, char *entry, int e
   *str_Length = length;
 }
 
-void hipo_read_record_(int *record, int *n_events) {
-  int pos = (*record) - 1;
-  hipo_FORT_Reader.readRecord(hipo_FORT_Record, pos);
-  int nevt = hipo_FORT_Record.getEventCount();
-  *n_events = nevt;
+void hipo_handle_set_cache_(int *handle, int *megabytes) { getHandle(*handle)->reader.setRecordCache(*megabytes); }
+
+void hipo_handle_read_record_(int *handle, int *record, int *n_events) {
+  hipo_handle *h = getHandle(*handle);
+  h->reader.readRecord(h->record, (*record) - 1);
+  *n_events = h->record.getEventCount();
+}
+
+void hipo_handle_read_event_(int *handle, int *n_event) {
+  hipo_handle *h = getHandle(*handle);
+  h->record.readHipoEvent(h->event, (*n_event) - 1);
+  h->current = &h->event;
+}
+
+void hipo_handle_read_float_(int *handle, int *group, int *item, int *nread, float *buffer, int *maxRows) {
+  readColumn(*handle, *group, *item, nread, buffer, *maxRows);
 }
 
-void hipo_read_event_(int *n_event) {
-  int event_index = (*n_event) - 1;
-  // std::vector<char> record_event;
-  // hipo_FORT_Record.readEvent(record_event,event_index);
-  hipo_FORT_Record.readHipoEvent(hipo_FORT_Event, event_index);
+void hipo_handle_read_int_(int *handle, int *group, int *item, int *nread, int *buffer, int *maxRows) {
+  readColumn(*handle, *group, *item, nread, buffer, *maxRows);
 }
 
+void hipo_handle_record_float_(int *handle, int *group, int *item, int *n_events, int *offsets, float *buffer,
+                               int *maxRows, int *nread) {
+  readRecordColumn(*handle, *group, *item, n_events, offsets, buffer, *maxRows, nread);
+}
+
+void hipo_handle_record_int_(int *handle, int *group, int *item, int *n_events, int *offsets, int *buffer,
+                             int *maxRows, int *nread) {
+  readRecordColumn(*handle, *group, *item, n_events, offsets, buffer, *maxRows, nread);
+}
+
+void hipo_handle_foreach_record_(int *handle, int *nthreads, hipo_record_callback callback) {
+  hipo_handle *h = getHandle(*handle);
+  int records = h->reader.getRecordCount();
+  int threads = *nthreads;
+  if (threads <= 0) threads = std::thread::hardware_concurrency();
+  if (threads > records) threads = records;
+  if (threads <= 0) threads = 1;
+
+  // records are handed out one at a time so slow records do not stall a thread
+  std::atomic<int> nextRecord(0);
+  auto work = [&]() {
+    int local = openHandle(h->filename.c_str(), false);
+    hipo_handle *w = getHandle(local);
+    while (true) {
+      int index = nextRecord.fetch_add(1);
+      if (index >= records) break;
+      w->reader.readRecord(w->record, index);
+      int record = index + 1;
+      int events = w->record.getEventCount();
+      callback(&local, &record, &events);
+    }
+    hipo_close_handle_(&local);
+  };
+  std::vector<std::thread> workers;
+  for (int i = 1; i < threads; i++) workers.push_back(std::thread(work));
+  work();
+  for (int i = 0; i < workers.size(); i++) workers[i].join();
+}
+
+//------------------------------------------------------------------
+// single file interface, works on the default handle
+//------------------------------------------------------------------
+
+void hipo_open_file_(int *nrecords, const char *filename, int length) {
+  std::string name(filename, length);
+  printf("[FORTRAN] opening file : %s\n", name.c_str());
+  if (hipo_FORT_Default > 0) hipo_close_handle_(&hipo_FORT_Default);
+  hipo_FORT_Default = openHandle(name.c_str(), true);
+  hipo_handle *h = getHandle(hipo_FORT_Default);
+  printf("[FORTRAN] dictionary length %d\n", h->dictionary.getEventCount());
+  *nrecords = h->reader.getRecordCount();
+}
+
+int hipo_file_next_(int *fstatus) { return hipo_handle_next_(&hipo_FORT_Default, fstatus); }
+
+void get_dict_length_(int *len) { hipo_handle_dict_length_(&hipo_FORT_Default, len); }
+
+void read_schema_(int *order, int *max_char, int *str_Length, char *entry, int entryLength) {
+  hipo_handle_read_schema_(&hipo_FORT_Default, order, max_char, str_Length, entry, entryLength);
+}
+
+void hipo_read_record_(int *record, int *n_events) { hipo_handle_read_record_(&hipo_FORT_Default, record, n_events); }
+
+void hipo_read_event_(int *n_event) { hipo_handle_read_event_(&hipo_FORT_Default, n_event); }
+
 void hipo_read_float_(int *group, int *item, int *nread, float *buffer, int *maxRows) {
-  int id_g = *group;
-  int id_i = *item;
-  int max = *maxRows;
-  // printf("READIN FLOAT %d %d \n",*group,*item);
-  std::vector<float> vec = hipo_FORT_Reader.getEvent()->getFloat(id_g, id_i);
-  // printf("RESULT SIZE = %d \n",vec.size());
-  for (int i = 0; i < vec.size(); i++) {
-    if (i < max) buffer[i] = vec[i];
-  }
-  *nread = vec.size();
+  hipo_handle_read_float_(&hipo_FORT_Default, group, item, nread, buffer, maxRows);
 }
 
 void hipo_read_int_(int *group, int *item, int *nread, int *buffer, int *maxRows) {
-  int id_g = *group;
-  int id_i = *item;
-  int max = *maxRows;
-  // printf("READIN INT %d %d \n",*group,*item);
-  std::vector<int> vec = hipo_FORT_Reader.getEvent()->getInt(id_g, id_i);
-  // printf("RESULT SIZE = %d \n",vec.size());
-  for (int i = 0; i < vec.size(); i++) {
-    if (i < max) buffer[i] = vec[i];
-  }
-  *nread = vec.size();
+  hipo_handle_read_int_(&hipo_FORT_Default, group, item, nread, buffer, maxRows);
 }
 
 void hipo_read_node_float_(int *group, int *item, int *nread, float *buffer) {
-  int id_g = *group;
-  int id_i = *item;
-  // printf("READIN FLOAT %d %d \n",*group,*item);
-  std::vector<float> vec = hipo_FORT_Reader.getEvent()->getFloat(id_g, id_i);
-  // printf("RESULT SIZE = %d \n",vec.size());
-  for (int i = 0; i < vec.size(); i++) {
-    buffer[i] = vec[i];
-  }
-  *nread = vec.size();
+  int max = 0x7FFFFFFF;
+  hipo_handle_read_float_(&hipo_FORT_Default, group, item, nread, buffer, &max);
 }
 
 void hipo_read_node_int_(int *group, int *item, int *nread, int *buffer) {
-  int id_g = *group;
-  int id_i = *item;
-  // printf("READIN INT %d %d \n",*group,*item);
-  std::vector<int> vec = hipo_FORT_Reader.getEvent()->getInt(id_g, id_i);
-  // printf("RESULT SIZE = %d \n",vec.size());
-  for (int i = 0; i < vec.size(); i++) {
-    buffer[i] = vec[i];
-  }
-  *nread = vec.size();
+  int max = 0x7FFFFFFF;
+  hipo_handle_read_int_(&hipo_FORT_Default, group, item, nread, buffer, &max);
 }
 }
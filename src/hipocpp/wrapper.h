@@ -0,0 +1,79 @@
+/*
+ * File:   wrapper.h
+ *
+ * Fortran/C interface to the reader. Every call takes an opaque
+ * integer handle returned by hipo_open_handle_, so several files can
+ * be open at the same time. A handle must only be used by one thread
+ * at a time, different handles can be used from different threads.
+ * All arguments are passed by reference (Fortran calling convention),
+ * record and event numbers are 1-based.
+ *
+ * The original single-file calls (hipo_open_file_, hipo_file_next_,
+ * hipo_read_float_, ...) are kept and work on a default handle.
+ */
+
+#ifndef HIPO_WRAPPER_H
+#define HIPO_WRAPPER_H
+
+extern "C" {
+
+/** called by hipo_handle_foreach_record_ for every record */
+typedef void (*hipo_record_callback)(int *handle, int *record, int *n_events);
+
+void hipo_open_handle_(int *handle, int *nrecords, const char *filename, int length);
+void hipo_close_handle_(int *handle);
+
+/** sequential reading, fstatus is 12 at the end of the file */
+int hipo_handle_next_(int *handle, int *fstatus);
+
+void hipo_handle_dict_length_(int *handle, int *len);
+void hipo_handle_read_schema_(int *handle, int *order, int *max_char, int *str_Length, char *entry, int entryLength);
+
+/** keeps up to megabytes of decompressed records for hipo_handle_read_record_ (0 disables) */
+void hipo_handle_set_cache_(int *handle, int *megabytes);
+
+/** random access, the record is loaded then events are selected in it */
+void hipo_handle_read_record_(int *handle, int *record, int *n_events);
+void hipo_handle_read_event_(int *handle, int *n_event);
+
+/**
+ * copies the column (group, item) of the current event into buffer,
+ * nread is the number of rows in the event, at most maxRows are copied.
+ */
+void hipo_handle_read_float_(int *handle, int *group, int *item, int *nread, float *buffer, int *maxRows);
+void hipo_handle_read_int_(int *handle, int *group, int *item, int *nread, int *buffer, int *maxRows);
+
+/**
+ * copies the column (group, item) of every event of the loaded record
+ * into buffer in one call. The rows of event i (0-based) are
+ * offsets[i] to offsets[i+1]-1, offsets needs n_events+1 entries.
+ * nread is the total number of rows, at most maxRows are copied.
+ */
+void hipo_handle_record_float_(int *handle, int *group, int *item, int *n_events, int *offsets, float *buffer,
+                               int *maxRows, int *nread);
+void hipo_handle_record_int_(int *handle, int *group, int *item, int *n_events, int *offsets, int *buffer,
+                             int *maxRows, int *nread);
+
+/**
+ * reads the records of the file on nthreads threads (0 = all cores).
+ * Each thread opens the file on its own handle and calls callback
+ * with that handle after loading a record into it, so the callback can
+ * use hipo_handle_read_event_ or the record calls above on it. The
+ * callback runs concurrently and in no particular record order.
+ */
+void hipo_handle_foreach_record_(int *handle, int *nthreads, hipo_record_callback callback);
+
+/** single file interface on the default handle */
+void hipo_open_file_(int *nrecords, const char *filename, int length);
+int hipo_file_next_(int *fstatus);
+void get_dict_length_(int *len);
+void read_schema_(int *order, int *max_char, int *str_Length, char *entry, int entryLength);
+void hipo_read_record_(int *record, int *n_events);
+void hipo_read_event_(int *n_event);
+void hipo_read_float_(int *group, int *item, int *nread, float *buffer, int *maxRows);
+void hipo_read_int_(int *group, int *item, int *nread, int *buffer, int *maxRows);
+void hipo_read_node_float_(int *group, int *item, int *nread, float *buffer);
+void hipo_read_node_int_(int *group, int *item, int *nread, int *buffer);
+}
+
+#endif /* HIPO_WRAPPER_H */
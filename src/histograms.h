@@ -0,0 +1,174 @@
+/**************************************/
+/*                                    */
+/*  Histograms filled while           */
+/*  converting, from a config file    */
+/*                                    */
+/**************************************/
+
+#ifndef HISTOGRAMS_H_GUARD
+#define HISTOGRAMS_H_GUARD
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "TDirectory.h"
+#include "TH1.h"
+#include "TH2.h"
+#include "columns.h"
+#include "expression.h"
+
+// The histograms listed in a config file, one per line:
+//
+//   # name     bins (x [y])         : x [, y]              [if cut]
+//   sf_vs_p    500 0 10 500 0 0.5   : p, ec_tot_energy / p  if pid == 11
+//   vz         200 -20 20           : vz                    if charge != 0
+//
+// Each event is evaluated for every row of the (particle or other bank)
+// columns used in the line, or once when only event columns are used.
+class HistogramSet {
+ private:
+  struct Histogram {
+    TH1 *hist;
+    Expression x;
+    Expression y;
+    Expression cut;
+    std::vector<Column *> rowColumns;
+    bool is2d;
+  };
+  std::vector<Histogram> histograms;
+
+  static std::string trim(const std::string &s) {
+    size_t first = s.find_first_not_of(" \t");
+    if (first == std::string::npos) return "";
+    return s.substr(first, s.find_last_not_of(" \t") - first + 1);
+  }
+
+  static void addRows(Histogram &h, Expression &e, const char *filename, const std::string &name) {
+    std::vector<Column *> &columns = e.getRowColumns();
+    for (int i = 0; i < columns.size(); i++) {
+      if (h.rowColumns.size() > 0 && h.rowColumns[0]->shape != columns[i]->shape) {
+        std::cerr << "[ERROR] histogram " << name << " in " << filename
+                  << " mixes particle columns with rows of another bank" << std::endl;
+        exit(1);
+      }
+      h.rowColumns.push_back(columns[i]);
+    }
+  }
+
+ public:
+  ~HistogramSet() {
+    for (int i = 0; i < histograms.size(); i++) delete histograms[i].hist;
+  }
+
+  void readConfig(const char *filename, ColumnRegistry &columns) {
+    std::ifstream config(filename);
+    if (!config.is_open()) {
+      std::cerr << "[ERROR] can not open histogram file : " << filename << std::endl;
+      exit(1);
+    }
+    std::string line;
+    while (std::getline(config, line)) {
+      std::string::size_type comment = line.find('#');
+      if (comment != std::string::npos) line.erase(comment);
+      if (trim(line) == "") continue;
+
+      std::string::size_type colon = line.find(':');
+      if (colon == std::string::npos) {
+        std::cerr << "[ERROR] missing ':' in histogram line : " << line << std::endl;
+        exit(1);
+      }
+      std::istringstream head(line.substr(0, colon));
+      std::string name;
+      std::vector<double> bins;
+      double number;
+      head >> name;
+      while (head >> number) bins.push_back(number);
+      if (name == "" || (bins.size() != 3 && bins.size() != 6)) {
+        std::cerr << "[ERROR] histogram " << name << " needs \"bins min max\" for x and optionally y" << std::endl;
+        exit(1);
+      }
+
+      std::string body = line.substr(colon + 1);
+      std::string cut;
+      std::string::size_type condition = body.find(" if ");
+      if (condition != std::string::npos) {
+        cut = body.substr(condition + 4);
+        body.erase(condition);
+      }
+      std::string xexpr = body;
+      std::string yexpr;
+      std::string::size_type comma = std::string::npos;
+      int depth = 0;
+      for (size_t i = 0; i < body.size(); i++) {
+        if (body[i] == '(') depth++;
+        if (body[i] == ')') depth--;
+        if (body[i] == ',' && depth == 0) comma = i;
+      }
+      if (comma != std::string::npos) {
+        xexpr = body.substr(0, comma);
+        yexpr = body.substr(comma + 1);
+      }
+      Histogram h;
+      h.is2d = (bins.size() == 6);
+      if (h.is2d != (trim(yexpr) != "")) {
+        std::cerr << "[ERROR] histogram " << name << " binning and expressions do not match" << std::endl;
+        exit(1);
+      }
+      h.x = Expression(trim(xexpr), columns);
+      addRows(h, h.x, filename, name);
+      if (h.is2d) {
+        h.y = Expression(trim(yexpr), columns);
+        addRows(h, h.y, filename, name);
+      }
+      if (trim(cut) != "") {
+        h.cut = Expression(trim(cut), columns);
+        addRows(h, h.cut, filename, name);
+      }
+      std::string title = trim(line.substr(colon + 1));
+      if (h.is2d)
+        h.hist = new TH2D(name.c_str(), title.c_str(), bins[0], bins[1], bins[2], bins[3], bins[4], bins[5]);
+      else
+        h.hist = new TH1D(name.c_str(), title.c_str(), bins[0], bins[1], bins[2]);
+      h.hist->SetDirectory(0);
+      histograms.push_back(h);
+    }
+  }
+
+  int size() { return histograms.size(); }
+
+  // Called with the joined columns of an accepted event
+  void fill() {
+    for (int i = 0; i < histograms.size(); i++) {
+      Histogram &h = histograms[i];
+      int rows = 1;
+      for (int c = 0; c < h.rowColumns.size(); c++) {
+        int l = columnSize(h.rowColumns[c]);
+        if (c == 0 || l < rows) rows = l;
+      }
+      for (int row = 0; row < rows; row++) {
+        if (!h.cut.empty() && !(h.cut.evaluate(row) != 0)) continue;
+        double x = h.x.evaluate(row);
+        if (!std::isfinite(x)) continue;
+        if (h.is2d) {
+          double y = h.y.evaluate(row);
+          if (!std::isfinite(y)) continue;
+          static_cast<TH2D *>(h.hist)->Fill(x, y);
+        } else {
+          h.hist->Fill(x);
+        }
+      }
+    }
+  }
+
+  void write(TDirectory *directory) {
+    directory->cd();
+    for (int i = 0; i < histograms.size(); i++) histograms[i].hist->Write();
+  }
+};
+
+#endif
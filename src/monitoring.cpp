@@ -0,0 +1,141 @@
+/*
+ *
+ * Daily monitoring plots (sampling fraction, W vs Q2, delta t, p vs beta)
+ * from dst2root output, with a multithreaded RDataFrame event loop.
+ * Works on the default clas12 tree (vector branches) and on the
+ * particles tree written with --flat.
+ */
+// Standard libs
+#include <chrono>
+#include <iostream>
+#include <string>
+// ROOT libs
+#include "ROOT/RDataFrame.hxx"
+#include "TFile.h"
+#include "TH1.h"
+#include "TH2.h"
+
+#include "clipp.h"
+
+static const double MASS_P = 0.93827203;
+static const double MASS_PIP = 0.13957018;
+static const double C_SPECIAL_UNITS = 29.9792458;
+
+int main(int argc, char **argv) {
+  std::string InFileName = "";
+  std::string OutFileName = "monitoring.root";
+  int threads = 0;
+  double beam = 2.2;
+  bool print_help = false;
+
+  auto cli = (clipp::option("-h", "--help").set(print_help) % "print help",
+              (clipp::option("-t", "--threads") & clipp::value("threads", threads)) % "Number of threads (0 = all cores)",
+              (clipp::option("-E", "--beam") & clipp::value("beam", beam)) % "Beam energy in GeV (default 2.2)",
+              clipp::value("inputFile.root", InFileName), clipp::opt_value("outputFile.root", OutFileName));
+
+  clipp::parse(argc, argv, cli);
+  if (print_help || InFileName == "") {
+    std::cout << clipp::make_man_page(cli, argv[0]);
+    exit(0);
+  }
+
+  TFile *input = TFile::Open(InFileName.c_str());
+  if (input == NULL || input->IsZombie()) {
+    std::cerr << "[ERROR] can not open " << InFileName << std::endl;
+    exit(1);
+  }
+  bool flat = (input->Get("particles") != NULL);
+  long input_size = input->GetSize();
+  input->Close();
+
+  ROOT::EnableImplicitMT(threads);
+  ROOT::RDataFrame df(flat ? "particles" : "clas12", InFileName);
+
+  // The same plots are booked for both layouts, only the expressions differ:
+  // with vector branches the first particle is x[0] and the particle
+  // selections are masks on the vectors, in the flat tree every entry is one
+  // particle, the first one has pindex == 0 and the selections are filters.
+  auto first = [&](const std::string &column) { return flat ? column : column + "[0]"; };
+  ROOT::RDF::RNode events = flat ? ROOT::RDF::RNode(df.Filter("pindex == 0")) : ROOT::RDF::RNode(df.Filter("pid.size() > 0"));
+  ROOT::RDF::RNode particles = df;
+  auto select = [&](ROOT::RDF::RNode node, const std::string &name, const std::string &x, const std::string &y,
+                    const std::string &mask) -> ROOT::RDF::RNode {
+    if (flat) return node.Filter(mask).Define(name + "_x", x).Define(name + "_y", y);
+    return node.Define(name + "_mask", mask)
+        .Define(name + "_x", "(" + x + ")[" + name + "_mask]")
+        .Define(name + "_y", "(" + y + ")[" + name + "_mask]");
+  };
+
+  auto count = df.Count();
+
+  // samplingFraction.C
+  auto sf_hist = events.Filter(first("pid") + " != 22 && " + first("pid") + " != 0 && " + first("p") + " != 0")
+                     .Define("sf_p", first("p"))
+                     .Define("sf", first("ec_tot_energy") + " / " + first("p"))
+                     .Histo2D({"sf_hist", "Electron Sampling Fraction", 500, 0, 3.5, 500, 0, 0.5}, "sf_p", "sf");
+
+  // WvsQ2.C, electron as first particle with a sampling fraction cut
+  std::string E = std::to_string(beam);
+  std::string M = std::to_string(MASS_P);
+  auto electrons = events.Filter(first("pid") + " == 11 && " + first("p") + " != 0")
+                       .Define("e_sf", first("ec_tot_energy") + " / " + first("p"))
+                       .Filter("e_sf > 0.2 && e_sf < 0.3")
+                       .Define("Q2", "2 * " + E + " * (" + first("p") + " - " + first("pz") + ")")
+                       .Define("W", "sqrt(" + M + " * " + M + " + 2 * " + M + " * (" + E + " - " + first("p") + ") - Q2)");
+  auto wq2 = electrons.Histo2D({"wq2", "W vs Q^{2}", 500, 0, 3.5, 500, 0, 6.0}, "W", "Q2");
+  auto w = electrons.Histo1D({"w", "W", 500, 0, 3.5}, "W");
+
+  // pvsb.C, every particle but the trigger one
+  std::string row = flat ? "pindex" : "ROOT::VecOps::Enumerate(p)";
+  auto pvsb = select(particles, "pvsb", "p", "beta", row + " >= 1 && beta >= 0.05 && charge != 0")
+                  .Histo2D({"MomVsBeta", "Momentum vs Beta", 500, 0, 3.5, 500, 0, 1.2}, "pvsb_x", "pvsb_y");
+
+  // deltat.C, vertex time from the first particle. A flat entry does not
+  // see the first particle, there the event start time is used and the
+  // histograms get their own names so they are not compared with deltat.C
+  std::string c = std::to_string(C_SPECIAL_UNITS);
+  std::string vertex = flat ? "STTime" : "(sc_ftof_time[0] - sc_ftof_path[0] / " + c + ")";
+  std::string dtName = flat ? "_st" : "";
+  std::string dtTitle = flat ? " (STTime vertex)" : "";
+  auto deltat = [&](double mass) {
+    std::string m2 = std::to_string(mass * mass);
+    return vertex + " - (sc_ftof_time - sc_ftof_path * sqrt(p * p + " + m2 + ") / (p * " + c + "))";
+  };
+  ROOT::RDF::RNode timed = flat ? particles : ROOT::RDF::RNode(df.Filter("pid.size() > 0"));
+  auto deltaT_prot = select(timed, "dt_prot", "p", deltat(MASS_P), "charge == 1 && p != 0")
+                         .Histo2D({("deltaT_prot" + dtName).c_str(), ("#Deltat Proton" + dtTitle).c_str(), 500, 0,
+                                   7.0, 500, -10, 10},
+                                  "dt_prot_x", "dt_prot_y");
+  auto deltaT_pip = select(timed, "dt_pip", "p", deltat(MASS_PIP), "charge == 1 && p != 0")
+                        .Histo2D({("deltaT_pion" + dtName).c_str(), ("#Deltat #pi^{+}" + dtTitle).c_str(), 500, 0,
+                                  7.0, 500, -10, 10},
+                                 "dt_pip_x", "dt_pip_y");
+  auto deltaT_pim = select(timed, "dt_pim", "p", deltat(MASS_PIP), "charge == -1 && p != 0")
+                        .Histo2D({("deltaT_pion_m" + dtName).c_str(), ("#Deltat #pi^{-}" + dtTitle).c_str(), 500,
+                                  0, 7.0, 500, -10, 10},
+                                 "dt_pim_x", "dt_pim_y");
+
+  // everything above is filled in one event loop, started here
+  auto start_full = std::chrono::high_resolution_clock::now();
+  long entries = *count;
+  std::chrono::duration<double> elapsed_full = (std::chrono::high_resolution_clock::now() - start_full);
+
+  TFile *output = new TFile(OutFileName.c_str(), "RECREATE");
+  sf_hist->Write();
+  wq2->Write();
+  w->Write();
+  pvsb->Write();
+  deltaT_prot->Write();
+  deltaT_pip->Write();
+  deltaT_pim->Write();
+  output->Close();
+
+  double seconds = elapsed_full.count();
+  std::cout << "Layout: " << (flat ? "flat (particles)" : "vector (clas12)") << ", threads: " << ROOT::GetThreadPoolSize()
+            << std::endl;
+  std::cout << "Elapsed time for " << entries << " entries: " << seconds << " s" << std::endl;
+  std::cout << "Entries/Sec: " << entries / seconds << " Hz" << std::endl;
+  std::cout << "Input MB/Sec: " << input_size / 1024.0 / 1024.0 / seconds << std::endl;
+
+  return 0;
+}
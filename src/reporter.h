@@ -0,0 +1,137 @@
+/**************************************/
+/*                                    */
+/*  Progress and run statistics       */
+/*                                    */
+/**************************************/
+
+#ifndef REPORTER_H_GUARD
+#define REPORTER_H_GUARD
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "reader.h"
+
+// Periodically prints conversion throughput from its own thread.
+// The input side is read from the hipo::reader counters, the main loop
+// only has to publish accepted events and output bytes written.
+class ProgressReporter {
+ private:
+  hipo::reader *reader;
+  std::atomic<long> eventsWritten;
+  std::atomic<long> bytesWritten;
+
+  std::chrono::steady_clock::time_point startTime;
+  double interval;
+  bool showProgress;
+
+  std::thread worker;
+  std::mutex lock;
+  std::condition_variable wakeup;
+  bool running;
+
+  static double MB(long bytes) { return bytes / 1024.0 / 1024.0; }
+
+  double elapsed() {
+    std::chrono::duration<double> dt = std::chrono::steady_clock::now() - startTime;
+    return dt.count();
+  }
+
+  void loop() {
+    std::unique_lock<std::mutex> guard(lock);
+    while (running) {
+      wakeup.wait_for(guard, std::chrono::duration<double>(interval));
+      if (running) printProgress();
+    }
+  }
+
+  void printProgress() {
+    double t = elapsed();
+    if (t <= 0) return;
+    long events = reader->getEventsRead();
+    long written = eventsWritten.load(std::memory_order_relaxed);
+    long position = reader->getPosition();
+    long size = reader->getInputSize();
+    double fraction = (size > 0) ? (double)position / size : 0.0;
+    double accepted = (events > 0) ? 100.0 * written / events : 0.0;
+    double eta = (fraction > 0) ? t * (1.0 - fraction) / fraction : 0.0;
+    fprintf(stderr, "\r\t%5.1f%% | %9.0f evt/s | in %7.2f MB/s (%7.2f MB/s unc) | out %7.2f MB/s | acc %5.1f%% | ETA %6.0f s ",
+            100.0 * fraction, events / t, MB(reader->getBytesCompressed()) / t, MB(reader->getBytesUncompressed()) / t,
+            MB(bytesWritten.load(std::memory_order_relaxed)) / t, accepted, eta);
+    fflush(stderr);
+  }
+
+ public:
+  ProgressReporter(hipo::reader *r, bool show, double seconds = 1.0) {
+    reader = r;
+    showProgress = show;
+    interval = seconds;
+    eventsWritten = 0;
+    bytesWritten = 0;
+    running = false;
+  }
+  ~ProgressReporter() { stop(); }
+
+  void start() {
+    startTime = std::chrono::steady_clock::now();
+    if (!showProgress) return;
+    running = true;
+    worker = std::thread(&ProgressReporter::loop, this);
+  }
+
+  void stop() {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      running = false;
+    }
+    wakeup.notify_all();
+    if (worker.joinable()) {
+      worker.join();
+      fprintf(stderr, "\n");
+    }
+  }
+
+  void setEventsWritten(long n) { eventsWritten.store(n, std::memory_order_relaxed); }
+  void setBytesWritten(long n) { bytesWritten.store(n, std::memory_order_relaxed); }
+
+  // Final statistics block, one "key : value" per line so that it is
+  // easy to grep in job logs and to parse from the batch scheduler.
+  std::string getStatistics() {
+    double t = elapsed();
+    long events = reader->getEventsRead();
+    long written = eventsWritten.load(std::memory_order_relaxed);
+    long in_c = reader->getBytesCompressed();
+    long in_u = reader->getBytesUncompressed();
+    long out = bytesWritten.load(std::memory_order_relaxed);
+    std::string block;
+    char line[256];
+    auto add = [&](const char *key, const char *fmt, double value) {
+      char number[64];
+      snprintf(number, sizeof(number), fmt, value);
+      snprintf(line, sizeof(line), "%-28s : %s\n", key, number);
+      block.append(line);
+    };
+    block.append("============ run statistics ============\n");
+    add("elapsed_time_s", "%.3f", t);
+    add("events_read", "%.0f", events);
+    add("events_written", "%.0f", written);
+    add("records_skipped", "%.0f", reader->getRecordsSkipped());
+    add("accepted_fraction", "%.6f", (events > 0) ? (double)written / events : 0.0);
+    add("events_per_s", "%.1f", (t > 0) ? events / t : 0.0);
+    add("input_compressed_MB", "%.3f", MB(in_c));
+    add("input_uncompressed_MB", "%.3f", MB(in_u));
+    add("output_MB", "%.3f", MB(out));
+    add("input_compressed_MB_per_s", "%.3f", (t > 0) ? MB(in_c) / t : 0.0);
+    add("input_uncompressed_MB_per_s", "%.3f", (t > 0) ? MB(in_u) / t : 0.0);
+    add("output_MB_per_s", "%.3f", (t > 0) ? MB(out) / t : 0.0);
+    block.append("========================================\n");
+    return block;
+  }
+};
+
+#endif
@@ -0,0 +1,208 @@
+/**************************************/
+/*                                    */
+/*  Several skims written in one      */
+/*  pass, each on its own thread      */
+/*                                    */
+/**************************************/
+
+#ifndef SKIMS_H_GUARD
+#define SKIMS_H_GUARD
+
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "TFile.h"
+#include "TTree.h"
+#include "columns.h"
+#include "expression.h"
+
+// One skim: a cut and an output file with the same tree as the main
+// output. The main loop evaluates the cut on the joined columns and hands
+// accepted events over as a flat copy of all columns, the writer thread
+// owns the file, its own column vectors and does Fill and Write.
+class SkimWriter {
+ private:
+  std::string name;
+  std::string filename;
+  Expression cut;
+  std::vector<Column *> columns;
+  long accepted;
+
+  std::deque<std::shared_ptr<std::vector<char>>> queue;
+  std::mutex lock;
+  std::condition_variable wakeup;
+  bool done;
+  bool waiting;  // one side sleeps on wakeup
+  std::thread worker;
+
+  static const int MAX_QUEUE = 2000;
+
+  void loop() {
+    TFile *file = new TFile(filename.c_str(), "RECREATE");
+    file->SetCompressionSettings(6);
+    TTree *tree = new TTree("clas12", name.c_str());
+    std::vector<void *> vectors(columns.size());
+    for (int c = 0; c < columns.size(); c++) vectors[c] = columns[c]->create(tree, columns[c]->name.c_str());
+
+    std::shared_ptr<std::vector<char>> event;
+    while (true) {
+      {
+        std::unique_lock<std::mutex> guard(lock);
+        while (queue.empty() && !done) {
+          waiting = true;
+          wakeup.wait(guard);
+        }
+        if (queue.empty()) break;
+        event = queue.front();
+        queue.pop_front();
+        if (waiting && queue.size() < MAX_QUEUE / 2) {
+          waiting = false;
+          wakeup.notify_all();
+        }
+      }
+      const char *buffer = event->data();
+      for (int c = 0; c < columns.size(); c++) buffer = columns[c]->load(vectors[c], buffer);
+      tree->Fill();
+    }
+
+    file->cd();
+    tree->Write();
+    file->Close();
+    for (int c = 0; c < columns.size(); c++) columns[c]->destroy(vectors[c]);
+  }
+
+ public:
+  SkimWriter(const std::string &n, const std::string &f, const Expression &e, const std::vector<Column *> &c) {
+    name = n;
+    filename = f;
+    cut = e;
+    columns = c;
+    accepted = 0;
+    done = false;
+    waiting = false;
+  }
+
+  void start() { worker = std::thread(&SkimWriter::loop, this); }
+
+  bool accept() { return cut.any(); }
+
+  // Queues one event, waits when the writer is too far behind
+  void push(const std::shared_ptr<std::vector<char>> &event) {
+    std::unique_lock<std::mutex> guard(lock);
+    while (queue.size() >= MAX_QUEUE) {
+      waiting = true;
+      wakeup.wait(guard);
+    }
+    queue.push_back(event);
+    if (waiting) {
+      waiting = false;
+      wakeup.notify_all();
+    }
+    accepted++;
+  }
+
+  void stop() {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      done = true;
+    }
+    wakeup.notify_all();
+    if (worker.joinable()) worker.join();
+  }
+
+  const std::string &getName() { return name; }
+  long getAccepted() { return accepted; }
+};
+
+// The skims listed in a config file, one per line:
+//
+//   # name      output file            cut
+//   electrons   skim_electrons.root    pid[0] == 11
+//   protons     skim_protons.root      pid == 2212 && abs(vz) < 10
+//
+// An event goes to every skim whose cut holds for at least one row.
+// The columns of the event are copied once and shared by all of them.
+class SkimSet {
+ private:
+  std::vector<SkimWriter *> skims;
+  std::vector<Column *> columns;
+  size_t eventSize = 0;
+
+ public:
+  ~SkimSet() {
+    for (int i = 0; i < skims.size(); i++) delete skims[i];
+  }
+
+  void readConfig(const char *filename, ColumnRegistry &registry, TTree *source) {
+    std::vector<Column> &all = registry.getColumns();
+    for (int i = 0; i < all.size(); i++) {
+      if (all[i].tree == source) columns.push_back(&all[i]);
+    }
+
+    std::ifstream config(filename);
+    if (!config.is_open()) {
+      std::cerr << "[ERROR] can not open skim file : " << filename << std::endl;
+      exit(1);
+    }
+    std::string line;
+    while (std::getline(config, line)) {
+      std::string::size_type comment = line.find('#');
+      if (comment != std::string::npos) line.erase(comment);
+      std::istringstream tokens(line);
+      std::string name;
+      std::string output;
+      if (!(tokens >> name)) continue;
+      std::string cut;
+      if (!(tokens >> output) || !std::getline(tokens, cut) || cut.find_first_not_of(" \t") == std::string::npos) {
+        std::cerr << "[ERROR] skim " << name << " in " << filename << " needs an output file and a cut" << std::endl;
+        exit(1);
+      }
+      skims.push_back(new SkimWriter(name, output, Expression(cut, registry), columns));
+    }
+  }
+
+  int size() { return skims.size(); }
+
+  void start() {
+    for (int i = 0; i < skims.size(); i++) skims[i]->start();
+  }
+
+  // Called with the joined columns of an accepted event
+  void fill() {
+    std::shared_ptr<std::vector<char>> event;
+    for (int i = 0; i < skims.size(); i++) {
+      if (!skims[i]->accept()) continue;
+      if (!event) {
+        event = std::make_shared<std::vector<char>>();
+        event->reserve(eventSize);
+        for (int c = 0; c < columns.size(); c++) columns[c]->save(columns[c]->address, *event);
+        if (event->size() > eventSize) eventSize = event->size();
+      }
+      skims[i]->push(event);
+    }
+  }
+
+  void stop() {
+    for (int i = 0; i < skims.size(); i++) skims[i]->stop();
+  }
+
+  std::string getSummary() {
+    std::string summary;
+    char line[256];
+    for (int i = 0; i < skims.size(); i++) {
+      snprintf(line, sizeof(line), "skim %-22s : %ld\n", skims[i]->getName().c_str(), skims[i]->getAccepted());
+      summary.append(line);
+    }
+    return summary;
+  }
+};
+
+#endif